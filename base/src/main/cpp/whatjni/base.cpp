@@ -1,12 +1,34 @@
 #include "whatjni/base.h"
+#include "whatjni/base_inline.h"
+#include "whatjni/batch.h"
+#include "whatjni/binding.h"
 #include "utf8.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define WHATJNI_SSE2
+
+    // AVX2 code is compiled with a target attribute and only called if the CPU supports it.
+    #if defined(__GNUC__) || defined(__clang__)
+        #include <immintrin.h>
+        #define WHATJNI_AVX2
+    #endif
+#endif
 
 #ifdef _WIN32
+    #include <intrin.h>
     #include <windows.h>
     #include <winnt.h>
 #else
@@ -14,6 +36,7 @@
         #define _GNU_SOURCE
     #endif
     #include <dlfcn.h>
+    #include <execinfo.h>
     #include <pthread.h>
 #endif
 
@@ -36,10 +59,18 @@ typedef void* Module;
 #endif
 
 static Module g_vm_module;
-static JavaVM* g_vm;
-static thread_local JNIEnv* g_env;
-static thread_local const char* g_stack_low;
-static thread_local size_t g_stack_size;
+static std::atomic<JavaVM*> g_vm{nullptr};
+#ifdef WHATJNI_INLINE
+WHATJNI_THREAD_LOCAL JNIEnv* g_env;
+WHATJNI_THREAD_LOCAL const char* g_stack_low;
+WHATJNI_THREAD_LOCAL size_t g_stack_size;
+WHATJNI_THREAD_LOCAL int g_deferred_check_depth;
+WHATJNI_THREAD_LOCAL batch* g_batch;
+WHATJNI_THREAD_LOCAL int g_deferred_deletion_depth;
+WHATJNI_THREAD_LOCAL thread_ref_counters* g_ref_counters;
+std::atomic<bool> g_track_ref_sites;
+std::atomic<uint64_t> g_global_ref_deletions;
+#endif
 
 typedef jint (JNICALL *JNI_CreateJavaVMFunc)(JavaVM **pvm, void **penv, void *args);
 static JNI_CreateJavaVMFunc JNI_CreateJavaVM;
@@ -51,6 +82,24 @@ static jmethodID g_hash_code_method;
 static jclass g_system_class;
 static jmethodID g_identity_hash_code_method;
 
+static jclass g_class_class;
+static jmethodID g_for_name_method;
+
+struct class_cache_entry {
+    std::string name;
+    jclass clazz;
+    class_cache_entry* next;
+};
+
+static const size_t CLASS_CACHE_BUCKETS = 256;
+static std::atomic<class_cache_entry*> g_class_cache[CLASS_CACHE_BUCKETS];
+static std::mutex g_class_cache_mutex;
+static std::atomic<jobject> g_class_loader{nullptr};
+
+static std::atomic<class_binding*> g_class_bindings{nullptr};
+static std::atomic<method_binding*> g_method_bindings{nullptr};
+static std::atomic<field_binding*> g_field_bindings{nullptr};
+
 jvm_error::jvm_error(jint error): error_(error) {
 }
 
@@ -60,11 +109,14 @@ jvm_error::jvm_error(const jvm_error& rhs): error_(rhs.error_) {
 jvm_error::~jvm_error() {
 }
 
-jvm_exception::jvm_exception(jobject exception): exception_(exception) {
+jvm_exception::jvm_exception(jobject exception) {
+    // A global ref, so the exception can be rethrown on another thread, e.g. from a std::future.
+    exception_ = new_global_ref(exception);
+    delete_local_ref(exception);
 }
 
 jvm_exception::jvm_exception(const jvm_exception& rhs) {
-    exception_ = g_env->NewLocalRef(rhs.exception_);
+    exception_ = new_global_ref(rhs.exception_);
 }
 
 jvm_exception::jvm_exception(jvm_exception&& rhs) {
@@ -73,46 +125,290 @@ jvm_exception::jvm_exception(jvm_exception&& rhs) {
 }
 
 jvm_exception::~jvm_exception() {
-    g_env->DeleteLocalRef(exception_);
+    if (exception_) {
+        delete_global_ref(exception_);
+    }
 }
 
 std::string jvm_exception::get_message() const {
-    static jclass clazz = find_class("java/lang/Throwable");
-    static jmethodID method = get_method_id(clazz, "getMessage", "()Ljava/lang/String;");
+    static jmethodID method = get_method_id(class_cache::get("java/lang/Throwable"), "getMessage",
+                                            "()Ljava/lang/String;");
     jstring message = (jstring) call_method<jobject>(exception_, method);
     if (message) {
-        jsize length = get_string_length(message);
-        jboolean is_copy;
-        const char16_t* chars = (const char16_t*) get_string_chars(message, &is_copy);
-        std::string result;
-        utf8::utf16to8(chars, chars + length, std::back_inserter(result));
-        release_string_chars(message, (const jchar*) chars);
+        std::string result = to_std_string(message);
+        delete_local_ref(message);
         return result;
     } else {
         return "null";
     }
 }
 
-static void check_error(int error_code) {
-    if (error_code != JNI_OK) {
-        throw jvm_error(error_code);
-    }
+void throw_pending_exception() {
+    jthrowable exception = get_env()->ExceptionOccurred();
+    get_env()->ExceptionClear();
+    throw jvm_exception(exception);
+}
+
+batch* set_current_batch(batch* b) {
+    batch* previous = g_batch;
+    g_batch = b;
+    return previous;
+}
+
+uint64_t get_num_global_ref_deletions() {
+    return g_global_ref_deletions.load(std::memory_order_relaxed);
 }
 
-static void check_exception() {
-    jobject exception = g_env->ExceptionOccurred();
-    if (exception) {
-        g_env->ExceptionClear();
-        throw jvm_exception(exception);
+deferred_exception_check::deferred_exception_check(): uncaught_exceptions_(std::uncaught_exceptions()) {
+    ++g_deferred_check_depth;
+}
+
+deferred_exception_check::~deferred_exception_check() noexcept(false) {
+    // Do not throw while unwinding; the exception stays pending for the next check.
+    if (--g_deferred_check_depth == 0 && std::uncaught_exceptions() == uncaught_exceptions_) {
+        check_exception();
     }
 }
 
-template <typename T>
-static T check_exception(T result) {
+void deferred_exception_check::check() {
     check_exception();
+}
+
+// Queued GlobalRefs are collected in per-thread chunks, which are pushed onto a lock-free stack when full, when the
+// thread exits and when the outermost deferred_global_ref_deletion goes out of scope. delete_queued_global_refs() takes
+// the whole stack with one exchange, so it is free of ABA problems.
+struct deletion_chunk {
+    static const size_t CAPACITY = 62;
+    deletion_chunk* next;
+    size_t size;
+    jobject refs[CAPACITY];
+};
+
+static std::atomic<deletion_chunk*> g_deletion_chunks{nullptr};
+static std::atomic<size_t> g_num_queued_deletions{0};
+
+static thread_local deletion_chunk* t_deletion_chunk;
+static thread_local bool t_deletion_chunk_retired;
+
+static void push_deletion_chunk(deletion_chunk* chunk) {
+    g_num_queued_deletions.fetch_add(chunk->size, std::memory_order_relaxed);
+    chunk->next = g_deletion_chunks.load(std::memory_order_relaxed);
+    while (!g_deletion_chunks.compare_exchange_weak(chunk->next, chunk, std::memory_order_release,
+                                                    std::memory_order_relaxed)) {
+    }
+}
+
+static void push_thread_deletion_chunk() {
+    if (t_deletion_chunk) {
+        if (t_deletion_chunk->size) {
+            push_deletion_chunk(t_deletion_chunk);
+        } else {
+            delete t_deletion_chunk;
+        }
+        t_deletion_chunk = nullptr;
+    }
+}
+
+// Pushes the current thread's partially filled chunk when the thread exits.
+struct deletion_chunk_retirer {
+    ~deletion_chunk_retirer() {
+        push_thread_deletion_chunk();
+        t_deletion_chunk_retired = true;
+    }
+};
+
+static thread_local deletion_chunk_retirer t_deletion_chunk_retirer;
+
+void queue_global_ref_deletion(jobject obj) {
+    if (!obj) {
+        return;
+    }
+
+    if (t_deletion_chunk_retired) {
+        // The thread is exiting; its chunk is gone.
+        push_deletion_chunk(new deletion_chunk{ nullptr, 1, { obj } });
+        return;
+    }
+
+    // Touch the retirer so it is constructed, and so destroyed, on this thread.
+    (void) &t_deletion_chunk_retirer;
+
+    if (!t_deletion_chunk) {
+        t_deletion_chunk = new deletion_chunk{ nullptr, 0, {} };
+    }
+    t_deletion_chunk->refs[t_deletion_chunk->size++] = obj;
+    if (t_deletion_chunk->size == deletion_chunk::CAPACITY) {
+        push_deletion_chunk(t_deletion_chunk);
+        t_deletion_chunk = nullptr;
+    }
+}
+
+size_t delete_queued_global_refs() {
+    deletion_chunk* chunk = g_deletion_chunks.exchange(nullptr, std::memory_order_acquire);
+    size_t count = 0;
+    JNIEnv* env = get_env();
+    while (chunk) {
+        bool track = g_track_ref_sites.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < chunk->size; ++i) {
+            count_ref(GLOBAL_REFS_DELETED);
+            if (track) {
+                untrack_ref_site(chunk->refs[i]);
+            }
+            env->DeleteGlobalRef(chunk->refs[i]);
+        }
+        count += chunk->size;
+        deletion_chunk* next = chunk->next;
+        delete chunk;
+        chunk = next;
+    }
+    g_num_queued_deletions.fetch_sub(count, std::memory_order_relaxed);
+    if (count) {
+        g_global_ref_deletions.fetch_add(count, std::memory_order_relaxed);
+    }
+    return count;
+}
+
+size_t get_num_queued_global_ref_deletions() {
+    return g_num_queued_deletions.load(std::memory_order_relaxed);
+}
+
+deferred_global_ref_deletion::deferred_global_ref_deletion() {
+    ++g_deferred_deletion_depth;
+}
+
+deferred_global_ref_deletion::~deferred_global_ref_deletion() {
+    if (--g_deferred_deletion_depth == 0) {
+        push_thread_deletion_chunk();
+    }
+}
+
+static std::mutex g_ref_counters_mutex;
+static std::vector<thread_ref_counters*> g_thread_ref_counters;
+static ref_counts g_exited_ref_counts;
+static uint64_t g_next_thread_id = 1;
+
+static void add_ref_counts(ref_counts* to, const thread_ref_counters& from) {
+    to->local_refs_created += from.counts[LOCAL_REFS_CREATED].load(std::memory_order_relaxed);
+    to->local_refs_deleted += from.counts[LOCAL_REFS_DELETED].load(std::memory_order_relaxed);
+    to->global_refs_created += from.counts[GLOBAL_REFS_CREATED].load(std::memory_order_relaxed);
+    to->global_refs_deleted += from.counts[GLOBAL_REFS_DELETED].load(std::memory_order_relaxed);
+    to->weak_refs_created += from.counts[WEAK_REFS_CREATED].load(std::memory_order_relaxed);
+    to->weak_refs_deleted += from.counts[WEAK_REFS_DELETED].load(std::memory_order_relaxed);
+    to->peak_frame_depth = std::max<uint64_t>(to->peak_frame_depth,
+                                              from.peak_frame_depth.load(std::memory_order_relaxed));
+}
+
+// Folds the thread's counters into the totals when it exits.
+struct ref_counters_owner {
+    ~ref_counters_owner() {
+        thread_ref_counters* counters = g_ref_counters;
+        if (!counters) {
+            return;
+        }
+
+        g_ref_counters = nullptr;
+        std::lock_guard<std::mutex> lock(g_ref_counters_mutex);
+        add_ref_counts(&g_exited_ref_counts, *counters);
+        g_thread_ref_counters.erase(std::find(g_thread_ref_counters.begin(), g_thread_ref_counters.end(), counters));
+        delete counters;
+    }
+};
+
+static thread_local ref_counters_owner t_ref_counters_owner;
+
+static void register_ref_counters() {
+    (void) &t_ref_counters_owner;
+
+    thread_ref_counters* counters = new thread_ref_counters{};
+    std::lock_guard<std::mutex> lock(g_ref_counters_mutex);
+    counters->thread_id = g_next_thread_id++;
+    g_thread_ref_counters.push_back(counters);
+    g_ref_counters = counters;
+}
+
+ref_stats_snapshot ref_stats() {
+    ref_stats_snapshot snapshot;
+    std::lock_guard<std::mutex> lock(g_ref_counters_mutex);
+    snapshot.total = g_exited_ref_counts;
+    for (thread_ref_counters* counters : g_thread_ref_counters) {
+        ref_counts counts;
+        counts.thread_id = counters->thread_id;
+        add_ref_counts(&counts, *counters);
+        add_ref_counts(&snapshot.total, *counters);
+        snapshot.threads.push_back(counts);
+    }
+    return snapshot;
+}
+
+struct ref_site {
+    jobjectRefType type;
+    std::vector<void*> frames;
+};
+
+static std::mutex g_ref_sites_mutex;
+static std::unordered_map<jobject, ref_site> g_ref_sites;
+
+void set_ref_site_tracking(bool enabled) {
+    g_track_ref_sites.store(enabled, std::memory_order_relaxed);
+}
+
+void track_ref_site(jobject obj, jobjectRefType type) {
+    const int MAX_FRAMES = 32;
+    void* frames[MAX_FRAMES];
+#ifdef _WIN32
+    int num_frames = CaptureStackBackTrace(1, MAX_FRAMES, frames, nullptr);
+#else
+    int num_frames = backtrace(frames, MAX_FRAMES);
+#endif
+
+    ref_site site = { type, std::vector<void*>(frames, frames + num_frames) };
+    std::lock_guard<std::mutex> lock(g_ref_sites_mutex);
+    g_ref_sites[obj] = std::move(site);
+}
+
+void untrack_ref_site(jobject obj) {
+    std::lock_guard<std::mutex> lock(g_ref_sites_mutex);
+    g_ref_sites.erase(obj);
+}
+
+std::vector<std::string> get_live_ref_sites() {
+    std::vector<std::string> result;
+    std::lock_guard<std::mutex> lock(g_ref_sites_mutex);
+    for (auto& entry : g_ref_sites) {
+        char header[64];
+        snprintf(header, sizeof(header), "%s %p created at:\n",
+                 entry.second.type == JNIWeakGlobalRefType ? "WeakGlobalRef" : "GlobalRef", (void*) entry.first);
+        std::string description = header;
+
+        auto& frames = entry.second.frames;
+#ifdef _WIN32
+        for (void* frame : frames) {
+            char line[32];
+            snprintf(line, sizeof(line), "    %p\n", frame);
+            description += line;
+        }
+#else
+        char** symbols = backtrace_symbols(frames.data(), int(frames.size()));
+        for (size_t i = 0; i < frames.size(); ++i) {
+            description += "    ";
+            description += symbols ? symbols[i] : "?";
+            description += "\n";
+        }
+        free(symbols);
+#endif
+
+        result.push_back(std::move(description));
+    }
     return result;
 }
 
+static void check_error(int error_code) {
+    if (error_code != JNI_OK) {
+        throw jvm_error(error_code);
+    }
+}
+
+
 static Module open_module(const string& modulePath) {
 #ifdef _WIN32
     return LoadLibrary(modulePath.c_str());
@@ -130,11 +426,28 @@ static void* lookup_module_symbol(Module module, const char* name) {
 }
 
 void initialize_thread(JNIEnv* env) {
+    if (batch* b = g_batch) {
+        batch_entered_native_method(b);
+    }
     if (g_env) {
+        // Native methods call this on entry, which makes it a convenient point to delete queued GlobalRefs.
+        if (g_deletion_chunks.load(std::memory_order_relaxed) && !g_deferred_deletion_depth) {
+            delete_queued_global_refs();
+        }
         return;
     }
 
     g_env = env;
+    if (!g_ref_counters) {
+        register_ref_counters();
+    }
+
+    // Modules loaded by a JVM they did not create learn of it from the first native method call.
+    if (!g_vm.load(std::memory_order_acquire)) {
+        JavaVM* vm;
+        check_error(env->GetJavaVM(&vm));
+        g_vm.store(vm, std::memory_order_release);
+    }
 
 #ifdef _WIN32
     if (GetCurrentThreadStackLimits) {
@@ -177,13 +490,98 @@ void initialize_thread(JNIEnv* env) {
 #endif  // _WIN32/__APPLE__
 }
 
-void initialize_thread() {
-    JNIEnv* env = g_env;
-    if (!env) {
-        check_error(g_vm->GetEnv((void**) &env, JNI_VERSION_1_8));
+static attach_options g_auto_attach_options;
+static std::mutex g_auto_attach_options_mutex;
+
+// Detaches a thread that was attached on first use when the thread exits.
+struct thread_attachment {
+    bool attached = false;
+
+    ~thread_attachment();
+};
+
+static thread_local thread_attachment t_attachment;
+static thread_local bool t_attachment_retired;
+
+thread_attachment::~thread_attachment() {
+    if (attached) {
+        g_vm.load(std::memory_order_acquire)->DetachCurrentThread();
+        g_env = nullptr;
+    }
+    t_attachment_retired = true;
+}
+
+// Returns true if this call attached the thread, false if it was already attached, e.g. because it is running a native
+// method called from Java.
+static bool attach_thread(const attach_options& options) {
+    JavaVM* vm = g_vm.load(std::memory_order_acquire);
+    if (!vm) {
+        throw jvm_error(JNI_EDETACHED);
+    }
+
+    JNIEnv* env;
+    jint result = vm->GetEnv((void**) &env, JNI_VERSION_1_8);
+    if (result == JNI_OK) {
+        initialize_thread(env);
+        return false;
+    } else if (result != JNI_EDETACHED) {
+        check_error(result);
+    }
+
+    JavaVMAttachArgs args = {
+        JNI_VERSION_1_8,
+        options.name.empty() ? nullptr : (char*) options.name.c_str(),
+        options.group,
+    };
+    if (options.daemon) {
+        check_error(vm->AttachCurrentThreadAsDaemon((void**) &env, &args));
+    } else {
+        check_error(vm->AttachCurrentThread((void**) &env, &args));
     }
 
     initialize_thread(env);
+    return true;
+}
+
+static void detach_thread() {
+    g_env = nullptr;
+    check_error(g_vm.load(std::memory_order_acquire)->DetachCurrentThread());
+}
+
+JNIEnv* attach_current_thread() {
+    // A thread_local destructor running after t_attachment's must not attach the thread, since nothing would detach it.
+    if (t_attachment_retired) {
+        if (g_env) {
+            return g_env;
+        }
+        throw jvm_error(JNI_EDETACHED);
+    }
+
+    attach_options options;
+    {
+        std::lock_guard<std::mutex> lock(g_auto_attach_options_mutex);
+        options = g_auto_attach_options;
+    }
+
+    if (attach_thread(options)) {
+        t_attachment.attached = true;
+    }
+    return g_env;
+}
+
+void set_auto_attach_options(const attach_options& options) {
+    std::lock_guard<std::mutex> lock(g_auto_attach_options_mutex);
+    g_auto_attach_options = options;
+}
+
+scoped_attach::scoped_attach(const attach_options& options) {
+    attached_ = !g_env && attach_thread(options);
+}
+
+scoped_attach::~scoped_attach() {
+    if (attached_) {
+        detach_thread();
+    }
 }
 
 static bool load_vm_module(const char* path) {
@@ -228,6 +626,10 @@ static void load_modules(const std::string& path) {
 }
 
 void initialize_vm(const vm_config& config) {
+    if (config.track_ref_sites) {
+        set_ref_site_tracking(true);
+    }
+
     load_modules(config.vm_module_path);
 
 #ifdef _WIN32
@@ -266,75 +668,196 @@ void initialize_vm(const vm_config& config) {
     };
 
     JNIEnv* env;
-    check_error(JNI_CreateJavaVM(&g_vm, (void**) &env, (void*) &init_args));
+    JavaVM* vm;
+    check_error(JNI_CreateJavaVM(&vm, (void**) &env, (void*) &init_args));
+    g_vm.store(vm, std::memory_order_release);
     initialize_thread(env);
 
-    g_object_class = find_class("java/lang/Object");
+    g_object_class = class_cache::get("java/lang/Object");
     g_equals_method = get_method_id(g_object_class, "equals", "(Ljava/lang/Object;)Z");
     g_hash_code_method = get_method_id(g_object_class, "hashCode", "()I");
 
-    g_system_class = find_class("java/lang/System");
+    g_system_class = class_cache::get("java/lang/System");
     g_identity_hash_code_method = get_static_method_id(g_system_class, "identityHashCode", "(Ljava/lang/Object;)I");
+
+    jclass class_loader_class = class_cache::get("java/lang/ClassLoader");
+    jmethodID get_system_class_loader_method = get_static_method_id(class_loader_class, "getSystemClassLoader",
+                                                                    "()Ljava/lang/ClassLoader;");
+    jobject class_loader = call_static_method<jobject>(class_loader_class, get_system_class_loader_method);
+    class_cache::set_class_loader(class_loader);
+    delete_local_ref(class_loader);
+
+    if (config.resolve_bindings) {
+        resolve_all_bindings();
+    }
 }
 
 void shutdown_vm() {
-    check_error(g_vm->DestroyJavaVM());
-    g_vm = nullptr;
+    class_cache::clear();
+    push_thread_deletion_chunk();
+    delete_queued_global_refs();
+
+    if (g_track_ref_sites.load(std::memory_order_relaxed)) {
+        for (auto& site : get_live_ref_sites()) {
+            std::cerr << site;
+        }
+    }
+
+    check_error(g_vm.load(std::memory_order_acquire)->DestroyJavaVM());
+    g_vm.store(nullptr, std::memory_order_release);
+    g_env = nullptr;
 }
 
 jclass find_class(const char* name) {
-    return check_exception(g_env->FindClass(name));
+    return check_exception(get_env()->FindClass(name));
+}
+
+static size_t hash_class_name(const char* name) {
+    // FNV-1a
+    size_t hash = 2166136261u;
+    for (; *name; ++name) {
+        hash = (hash ^ (unsigned char) *name) * 16777619u;
+    }
+    return hash;
+}
+
+static jclass load_class(const char* name) {
+    jobject loader = g_class_loader.load(std::memory_order_acquire);
+    if (!loader) {
+        return find_class(name);
+    }
+
+    // Class.forName expects a binary name, e.g. "java.lang.String", rather than "java/lang/String".
+    string binary_name(name);
+    std::replace(binary_name.begin(), binary_name.end(), '/', '.');
+
+    jstring java_name = new_utf8_string(binary_name.c_str());
+    jclass clazz = (jclass) call_static_method<jobject>(g_class_class, g_for_name_method, java_name, jboolean(JNI_TRUE),
+                                                        loader);
+    delete_local_ref(java_name);
+    return clazz;
+}
+
+jclass class_cache::get(const char* name) {
+    std::atomic<class_cache_entry*>& bucket = g_class_cache[hash_class_name(name) % CLASS_CACHE_BUCKETS];
+    for (auto entry = bucket.load(std::memory_order_acquire); entry; entry = entry->next) {
+        if (entry->name == name) {
+            return entry->clazz;
+        }
+    }
+
+    jclass local = load_class(name);
+    jclass global = (jclass) new_global_ref(local);
+    delete_local_ref(local);
+
+    std::lock_guard<std::mutex> lock(g_class_cache_mutex);
+
+    // Another thread might have cached the class while this one was loading it.
+    for (auto entry = bucket.load(std::memory_order_relaxed); entry; entry = entry->next) {
+        if (entry->name == name) {
+            delete_global_ref(global);
+            return entry->clazz;
+        }
+    }
+
+    bucket.store(new class_cache_entry{name, global, bucket.load(std::memory_order_relaxed)}, std::memory_order_release);
+    return global;
+}
+
+void class_cache::set_class_loader(jobject loader) {
+    if (!g_class_class) {
+        jclass local = find_class("java/lang/Class");
+        g_class_class = (jclass) new_global_ref(local);
+        delete_local_ref(local);
+        g_for_name_method = get_static_method_id(g_class_class, "forName",
+                                                 "(Ljava/lang/String;ZLjava/lang/ClassLoader;)Ljava/lang/Class;");
+    }
+
+    jobject global = loader ? new_global_ref(loader) : nullptr;
+    jobject previous = g_class_loader.exchange(global, std::memory_order_acq_rel);
+    if (previous) {
+        delete_global_ref(previous);
+    }
+}
+
+void class_cache::clear() {
+    std::lock_guard<std::mutex> lock(g_class_cache_mutex);
+    for (auto& bucket : g_class_cache) {
+        auto entry = bucket.exchange(nullptr, std::memory_order_acq_rel);
+        while (entry) {
+            auto next = entry->next;
+            delete_global_ref(entry->clazz);
+            delete entry;
+            entry = next;
+        }
+    }
+
+    jobject loader = g_class_loader.exchange(nullptr, std::memory_order_acq_rel);
+    if (loader) {
+        delete_global_ref(loader);
+    }
+
+    // Class bindings hold the GlobalRefs deleted above. Method and field IDs are only valid while their classes are.
+    for (auto binding = g_class_bindings.load(std::memory_order_acquire); binding; binding = binding->next_) {
+        binding->clazz_.store(nullptr, std::memory_order_release);
+    }
+    for (auto binding = g_method_bindings.load(std::memory_order_acquire); binding; binding = binding->next_) {
+        binding->id_.store(nullptr, std::memory_order_release);
+    }
+    for (auto binding = g_field_bindings.load(std::memory_order_acquire); binding; binding = binding->next_) {
+        binding->id_.store(nullptr, std::memory_order_release);
+    }
 }
 
 jclass get_super_class(jclass clazz) {
-    return check_exception(g_env->GetSuperclass(clazz));
+    return check_exception(get_env()->GetSuperclass(clazz));
 }
 
 jboolean is_assignable_from(jclass clazz1, jclass clazz2) {
-    auto result = g_env->IsAssignableFrom(clazz1, clazz2);
+    auto result = get_env()->IsAssignableFrom(clazz1, clazz2);
     check_exception();
     return result;
 }
 
 jboolean is_instance_of(jobject obj, jclass clazz) {
-    auto result = g_env->IsInstanceOf(obj, clazz);
+    auto result = get_env()->IsInstanceOf(obj, clazz);
     check_exception();
     return result;
 }
 
+jclass get_object_class(jobject obj) {
+    return check_exception(get_env()->GetObjectClass(obj));
+}
+
+jobject to_reflected_method(jclass clazz, jmethodID method, jboolean is_static) {
+    return check_exception(get_env()->ToReflectedMethod(clazz, method, is_static));
+}
+
 jfieldID get_field_id(jclass clazz, const char* name, const char* sig) {
-    return check_exception(g_env->GetFieldID(clazz, name, sig));
+    return check_exception(get_env()->GetFieldID(clazz, name, sig));
 }
 
 jfieldID get_static_field_id(jclass clazz, const char* name, const char* sig) {
-    return check_exception(g_env->GetStaticFieldID(clazz, name, sig));
+    return check_exception(get_env()->GetStaticFieldID(clazz, name, sig));
 }
 
 jmethodID get_method_id(jclass clazz, const char* name, const char* sig) {
-    return check_exception(g_env->GetMethodID(clazz, name, sig));
+    return check_exception(get_env()->GetMethodID(clazz, name, sig));
 }
 
 jmethodID get_static_method_id(jclass clazz, const char* name, const char* sig) {
-    return check_exception(g_env->GetStaticMethodID(clazz, name, sig));
+    return check_exception(get_env()->GetStaticMethodID(clazz, name, sig));
 }
 
 jobject alloc_object(jclass clazz) {
-    return check_exception(g_env->AllocObject(clazz));
+    return check_exception(get_env()->AllocObject(clazz));
 }
 
-jobject new_object(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    jobject result = g_env->NewObjectV(clazz, method, args);
-    va_end(args);
-    return check_exception(result);
+jobject new_object_a(jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->NewObjectA(clazz, method, args));
 }
 
-jboolean is_same_object(jobject l, jobject r) {
-    auto result = g_env->IsSameObject(l, r);
-    check_exception();
-    return result;
-}
 
 jboolean is_equal_object(jobject l, jobject r) {
     if (l) {
@@ -356,867 +879,472 @@ jint get_identity_hash_code(jobject obj) {
     return call_static_method<jint>(g_system_class, g_identity_hash_code_method, obj);
 }
 
-jobject new_local_ref(jobject obj) {
-    return check_exception(g_env->NewLocalRef(obj));
-}
-
-void delete_local_ref(jobject obj) {
-    g_env->DeleteLocalRef(obj);
-    check_exception();
+void print_exception() {
+    get_env()->ExceptionDescribe();
 }
 
-jobject new_global_ref(jobject obj) {
-    return check_exception(g_env->NewGlobalRef(obj));
-}
 
-void delete_global_ref(jobject obj) {
-    g_env->DeleteGlobalRef(obj);
-    check_exception();
+jstring new_string(const jchar* str, jsize length) {
+    return check_exception(get_env()->NewString(str, length));
 }
 
-jobject new_weak_global_ref(jobject obj) {
-    return check_exception(g_env->NewWeakGlobalRef(obj));
+static unsigned count_trailing_zeros(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
 }
 
-void delete_weak_global_ref(jobject obj) {
-    g_env->DeleteWeakGlobalRef(obj);
-    check_exception();
-}
+// The JNI "modified UTF-8" encoding differs from UTF-8 in its representation of null characters and characters
+// requiring a 4-byte sequence in UTF-8. In that case, transcode to a temporary UTF-16 string before passing
+// to JNI API.
+// https://docs.oracle.com/javase/7/docs/technotes/guides/jni/spec/types.html#wp16542
+//
+// A byte rules out the fast path if it is null or the first byte of a 4-byte sequence, i.e. if (byte - 1) >= 0xEF as an
+// unsigned byte. The classifiers below test 32 (AVX2), 16 (SSE2) or 1 byte at a time.
 
-jobjectRefType get_object_ref_type(jobject obj) {
-    return check_exception(g_env->GetObjectRefType(obj));
+static bool is_modified_utf8_compatible_scalar(const char* str, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (((unsigned char) (str[i] - 1)) >= 0xEF) {
+            return false;
+        }
+    }
+    return true;
 }
 
-static bool is_auto_ref_local(jobject* refref) {
-    const char* address = (const char*) refref;
-    return address - g_stack_low < g_stack_size;
-}
+#ifdef WHATJNI_SSE2
 
-void new_auto_ref(jobject* refref, jobject obj) {
-    if (is_auto_ref_local(refref)) {
-        *refref = new_local_ref(obj);
-    } else {
-        *refref = new_global_ref(obj);
+static bool is_modified_utf8_compatible_sse2(const char* str, size_t length) {
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i ef = _mm_set1_epi8((char) 0xEF);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_sub_epi8(_mm_loadu_si128((const __m128i*) (str + i)), one);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(chunk, ef), chunk))) {
+            return false;
+        }
     }
+    return is_modified_utf8_compatible_scalar(str + i, length - i);
 }
 
-void move_auto_ref(jobject* to, jobject* from) {
-    bool toLocal = is_auto_ref_local(to);
-    bool fromLocal = is_auto_ref_local(from);
-
-    if (toLocal == fromLocal) {
-        *to = *from;
-    } else if (toLocal) {
-        *to = new_local_ref(*from);
-        delete_global_ref(*from);
-    } else {
-        *to = new_global_ref(*from);
-        delete_local_ref(*from);
-    }
+#endif  // WHATJNI_SSE2
 
-    *from = nullptr;
-}
+#ifdef WHATJNI_AVX2
 
-void delete_auto_ref(jobject* refref) {
-    if (is_auto_ref_local(refref)) {
-        delete_local_ref(*refref);
-    } else {
-        delete_global_ref(*refref);
+__attribute__((target("avx2")))
+static bool is_modified_utf8_compatible_avx2(const char* str, size_t length) {
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i ef = _mm256_set1_epi8((char) 0xEF);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i chunk = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*) (str + i)), one);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(chunk, ef), chunk))) {
+            return false;
+        }
     }
+    return is_modified_utf8_compatible_sse2(str + i, length - i);
 }
 
-void print_exception() {
-    g_env->ExceptionDescribe();
+static bool has_avx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
 }
 
+static const bool g_has_avx2 = has_avx2();
 
-template <>
-void set_field(jobject obj, jfieldID field, jboolean value) {
-    g_env->SetBooleanField(obj, field, value);
-    check_exception();
+#endif  // WHATJNI_AVX2
+
+static bool is_modified_utf8_compatible(const char* str, size_t length) {
+#if defined(WHATJNI_AVX2)
+    if (g_has_avx2) {
+        return is_modified_utf8_compatible_avx2(str, length);
+    }
+    return is_modified_utf8_compatible_sse2(str, length);
+#elif defined(WHATJNI_SSE2)
+    return is_modified_utf8_compatible_sse2(str, length);
+#else
+    return is_modified_utf8_compatible_scalar(str, length);
+#endif
 }
 
-template<>
-jboolean get_field(jobject obj, jfieldID field) {
-    return check_exception(g_env->GetBooleanField(obj, field));
+// Finds the terminating null and classifies the string in the same pass. The SSE2 version reads aligned 16 byte blocks,
+// which never cross a page boundary, so it may read a few bytes either side of the string but never faults.
+#if defined(__clang__) || defined(__GNUC__)
+__attribute__((no_sanitize_address))
+#endif
+static size_t scan_utf8_string(const char* str, bool* compatible) {
+#ifdef WHATJNI_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i f0 = _mm_set1_epi8((char) 0xF0);
+    const char* block = (const char*) (uintptr_t(str) & ~uintptr_t(15));
+    unsigned valid = (0xFFFFu << (str - block)) & 0xFFFFu;
+    bool result = true;
+    for (;; block += 16, valid = 0xFFFF) {
+        __m128i chunk = _mm_load_si128((const __m128i*) block);
+        unsigned nul = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero)) & valid;
+        unsigned high = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(chunk, f0), chunk)) & valid;
+        if (nul) {
+            unsigned before_nul = (nul & (0u - nul)) - 1;
+            *compatible = result && !(high & before_nul);
+            return size_t(block + count_trailing_zeros(nul) - str);
+        }
+        if (high) {
+            result = false;
+        }
+    }
+#else
+    bool result = true;
+    size_t i = 0;
+    for (; str[i]; ++i) {
+        if (((unsigned char) str[i]) >= 0xF0) {
+            result = false;
+        }
+    }
+    *compatible = result;
+    return i;
+#endif
 }
 
+// A buffer for one conversion. Up to MAX_RETAINED_BUFFER_SIZE bytes, each thread reuses one buffer per element type
+// from one call to the next. Larger buffers are freed after use, so one long string does not hold memory for the life
+// of the thread.
+static const size_t MAX_RETAINED_BUFFER_SIZE = 64 * 1024;
 
-template <>
-void set_field(jobject obj, jfieldID field, jbyte value) {
-    g_env->SetByteField(obj, field, value);
-    check_exception();
-}
+template <typename T>
+class scratch_buffer {
+    std::unique_ptr<T[]> unretained_;
+    T* data_;
+public:
+    explicit scratch_buffer(size_t length) {
+        static thread_local std::unique_ptr<T[]> retained;
+        static thread_local size_t capacity;
+        if (length > MAX_RETAINED_BUFFER_SIZE / sizeof(T)) {
+            unretained_.reset(new T[length]);
+            data_ = unretained_.get();
+            return;
+        }
+        if (capacity < length) {
+            retained.reset(new T[length]);
+            capacity = length;
+        }
+        data_ = retained.get();
+    }
 
+    scratch_buffer(const scratch_buffer&) = delete;
+    scratch_buffer& operator=(const scratch_buffer&) = delete;
 
-template<>
-jbyte get_field(jobject obj, jfieldID field) {
-    return check_exception(g_env->GetByteField(obj, field));
+    T* get() const {
+        return data_;
+    }
+};
+
+static jstring new_slow_utf8_string(const char* str, size_t length) {
+    // UTF-16 never needs more code units than UTF-8 needs bytes.
+    scratch_buffer<char16_t> scratch(length);
+    char16_t* buffer = scratch.get();
+    char16_t* end = utf8::utf8to16(str, str + length, buffer);
+    return check_exception(get_env()->NewString((const jchar*) buffer, jsize(end - buffer)));
 }
 
+jstring new_utf8_string(const char* str, jsize length) {
+    if (!is_modified_utf8_compatible(str, length)) {
+        return new_slow_utf8_string(str, length);
+    }
 
-template <>
-void set_field(jobject obj, jfieldID field, jshort value) {
-    g_env->SetShortField(obj, field, value);
-    check_exception();
+    // NewStringUTF needs a null terminator, which str might not have at length.
+    scratch_buffer<char> scratch(size_t(length) + 1);
+    char* terminated = scratch.get();
+    memcpy(terminated, str, length);
+    terminated[length] = 0;
+    return check_exception(get_env()->NewStringUTF(terminated));
 }
 
-template<>
-jshort get_field(jobject obj, jfieldID field) {
-    return check_exception(g_env->GetShortField(obj, field));
+jstring new_utf8_string(const char* str) {
+    bool compatible;
+    size_t length = scan_utf8_string(str, &compatible);
+    if (compatible) {
+        return check_exception(get_env()->NewStringUTF(str));
+    } else {
+        return new_slow_utf8_string(str, length);
+    }
 }
 
+jstring new_global_utf8_string(const char* str, jsize length, bool intern) {
+    static jmethodID intern_method = get_method_id(class_cache::get("java/lang/String"), "intern",
+                                                   "()Ljava/lang/String;");
 
-template <>
-void set_field(jobject obj, jfieldID field, jint value) {
-    g_env->SetIntField(obj, field, value);
-    check_exception();
+    jstring local = new_utf8_string(str, length);
+    if (intern) {
+        jstring interned = (jstring) call_method<jobject>(local, intern_method);
+        delete_local_ref(local);
+        local = interned;
+    }
+
+    jstring global = (jstring) new_global_ref(local);
+    delete_local_ref(local);
+    return global;
 }
 
-template<>
-jint get_field(jobject obj, jfieldID field) {
-    return check_exception(g_env->GetIntField(obj, field));
+jsize get_string_length(jstring str) {
+    return check_exception(get_env()->GetStringLength(str));
 }
 
+const jchar* get_string_chars(jstring str, jboolean* is_copy) {
+    return check_exception(get_env()->GetStringChars(str, is_copy));
+}
 
-template <>
-void set_field(jobject obj, jfieldID field, jlong value) {
-    g_env->SetLongField(obj, field, value);
+void release_string_chars(jstring str, const jchar* chars) {
+    get_env()->ReleaseStringChars(str, chars);
     check_exception();
 }
 
-template<>
-jlong get_field(jobject obj, jfieldID field) {
-    return check_exception(g_env->GetLongField(obj, field));
+jsize get_string_utf_length(jstring str) {
+    return check_exception(get_env()->GetStringUTFLength(str));
 }
 
-template <>
-void set_field(jobject obj, jfieldID field, jchar value) {
-    g_env->SetCharField(obj, field, value);
+void get_string_region(jstring str, jsize start, jsize length, jchar* buffer) {
+    get_env()->GetStringRegion(str, start, length, buffer);
     check_exception();
 }
-template<>
-jchar get_field(jobject obj, jfieldID field) {
-    return check_exception(g_env->GetCharField(obj, field));
+
+void get_string_utf_region(jstring str, jsize start, jsize length, char* buffer) {
+    get_env()->GetStringUTFRegion(str, start, length, buffer);
+    check_exception();
 }
 
-
-template <>
-void set_field(jobject obj, jfieldID field, jfloat value) {
-    g_env->SetFloatField(obj, field, value);
-    check_exception();
-}
-
-template<>
-jfloat get_field(jobject obj, jfieldID field) {
-    return check_exception(g_env->GetFloatField(obj, field));
-}
-
-
-template <>
-void set_field(jobject obj, jfieldID field, jdouble value) {
-    g_env->SetDoubleField(obj, field, value);
-    check_exception();
-}
-
-template<>
-jdouble get_field(jobject obj, jfieldID field) {
-    return check_exception(g_env->GetDoubleField(obj, field));
-}
-
-
-template <>
-void set_field(jobject obj, jfieldID field, jobject value) {
-    g_env->SetObjectField(obj, field, value);
-    check_exception();
-}
-
-template<>
-jobject get_field(jobject obj, jfieldID field) {
-    return check_exception(g_env->GetObjectField(obj, field));
-}
-
-
-template<>
-jbyte get_static_field(jclass clazz, jfieldID field) {
-    return check_exception(g_env->GetStaticByteField(clazz, field));
-}
-
-
-template <>
-void set_static_field(jclass clazz, jfieldID field, jshort value) {
-    g_env->SetStaticShortField(clazz, field, value);
-    check_exception();
-}
-
-template<>
-jshort get_static_field(jclass clazz, jfieldID field) {
-    return check_exception(g_env->GetStaticShortField(clazz, field));
-}
-
-
-template <>
-void set_static_field(jclass clazz, jfieldID field, jint value) {
-    g_env->SetStaticIntField(clazz, field, value);
-    check_exception();
-}
-
-template<>
-jint get_static_field(jclass clazz, jfieldID field) {
-    return check_exception(g_env->GetStaticIntField(clazz, field));
-}
-
-
-template <>
-void set_static_field(jclass clazz, jfieldID field, jlong value) {
-    g_env->SetStaticLongField(clazz, field, value);
-    check_exception();
-}
-
-template<>
-jlong get_static_field(jclass clazz, jfieldID field) {
-    return check_exception(g_env->GetStaticLongField(clazz, field));
-}
-
-template <>
-void set_static_field(jclass clazz, jfieldID field, jchar value) {
-    g_env->SetStaticCharField(clazz, field, value);
-    check_exception();
-}
-template<>
-jchar get_static_field(jclass clazz, jfieldID field) {
-    return check_exception(g_env->GetStaticCharField(clazz, field));
-}
-
-
-template <>
-void set_static_field(jclass clazz, jfieldID field, jfloat value) {
-    g_env->SetStaticFloatField(clazz, field, value);
-    check_exception();
-}
-
-template<>
-jfloat get_static_field(jclass clazz, jfieldID field) {
-    return check_exception(g_env->GetStaticFloatField(clazz, field));
-}
-
-
-template <>
-void set_static_field(jclass clazz, jfieldID field, jdouble value) {
-    g_env->SetStaticDoubleField(clazz, field, value);
-    check_exception();
-}
-
-template<>
-jdouble get_static_field(jclass clazz, jfieldID field) {
-    return check_exception(g_env->GetStaticDoubleField(clazz, field));
-}
-
-
-template <>
-void set_static_field(jclass clazz, jfieldID field, jobject value) {
-    g_env->SetStaticObjectField(clazz, field, value);
-    check_exception();
-}
-
-template<>
-jobject get_static_field(jclass clazz, jfieldID field) {
-    return check_exception(g_env->GetStaticObjectField(clazz, field));
-}
-
-
-template <>
-void call_method(jobject obj, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    g_env->CallVoidMethodV(obj, method, args);
-    va_end(args);
-    check_exception();
-}
-
-template <>
-jboolean call_method(jobject obj, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallBooleanMethodV(obj, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jbyte call_method(jobject obj, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallByteMethodV(obj, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jshort call_method(jobject obj, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallShortMethodV(obj, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jint call_method(jobject obj, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallIntMethodV(obj, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jlong call_method(jobject obj, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallLongMethodV(obj, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jchar call_method(jobject obj, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallCharMethodV(obj, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jfloat call_method(jobject obj, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallFloatMethodV(obj, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jdouble call_method(jobject obj, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallDoubleMethodV(obj, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jobject call_method(jobject obj, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallObjectMethodV(obj, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-
-template <>
-void call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    g_env->CallNonvirtualVoidMethodV(obj, clazz, method, args);
-    va_end(args);
-    check_exception();
-}
-
-template <>
-jboolean call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallNonvirtualBooleanMethodV(obj, clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jbyte call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallNonvirtualByteMethodV(obj, clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jshort call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallNonvirtualShortMethodV(obj, clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jint call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallNonvirtualIntMethodV(obj, clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jlong call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallNonvirtualLongMethodV(obj, clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jchar call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallNonvirtualCharMethodV(obj, clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jfloat call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallNonvirtualFloatMethodV(obj, clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jdouble call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallNonvirtualDoubleMethodV(obj, clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jobject call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallNonvirtualObjectMethodV(obj, clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-
-template <>
-void call_static_method(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    g_env->CallStaticVoidMethodV(clazz, method, args);
-    va_end(args);
-    check_exception();
-}
-
-template <>
-jboolean call_static_method(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallStaticBooleanMethodV(clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jbyte call_static_method(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallStaticByteMethodV(clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jshort call_static_method(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallStaticShortMethodV(clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jint call_static_method(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallStaticIntMethodV(clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jlong call_static_method(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallStaticLongMethodV(clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jchar call_static_method(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallStaticCharMethodV(clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jfloat call_static_method(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallStaticFloatMethodV(clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jdouble call_static_method(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallStaticDoubleMethodV(clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-template <>
-jobject call_static_method(jclass clazz, jmethodID method, ...) {
-    va_list args;
-    va_start(args, method);
-    auto result = g_env->CallStaticObjectMethodV(clazz, method, args);
-    va_end(args);
-    return check_exception(result);
-}
-
-jstring new_string(const jchar* str, jsize length) {
-    return check_exception(g_env->NewString(str, length));
-}
-
-// The JNI "modified UTF-8" encoding differs from UTF-8 in its representation of null characters and characters
-// requiring a 4-byte sequence in UTF-8. In that case, transcode to a temporary UTF-16 string before passing
-// to JNI API.
-// https://docs.oracle.com/javase/7/docs/technotes/guides/jni/spec/types.html#wp16542
-static jstring new_slow_utf8_string(const char* str, jsize length) {
-    std::u16string str16;
-    str16.reserve(length);
-    utf8::utf8to16(str, str + length, std::back_inserter(str16));
-    return g_env->NewString((const jchar*) str16.data(), str16.length());
-}
-
-jstring new_utf8_string(const char* str, jsize length) {
-    bool fastPath = true;
-    for (size_t i = 0; i < length; ++i) {
-        char c = str[i];
-        if (((unsigned char) (c - 1)) >= 0xEF) {  // null character or first byte of a 4 byte character
-            fastPath = false;
-            break;
+// Index of the first byte that might begin a sequence where modified UTF-8 differs from standard UTF-8, or length if
+// there is none.
+static size_t find_modified_utf8_sequence(const char* str, size_t length) {
+    size_t i = 0;
+#ifdef WHATJNI_SSE2
+    const __m128i c0 = _mm_set1_epi8((char) 0xC0);
+    const __m128i ed = _mm_set1_epi8((char) 0xED);
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (str + i));
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, c0), _mm_cmpeq_epi8(chunk, ed)));
+        if (mask) {
+            return i + count_trailing_zeros(mask);
         }
     }
+#endif
 
-    if (fastPath) {
-        return g_env->NewStringUTF(str);
-    } else {
-        return new_slow_utf8_string(str, length);
-    }
-}
-
-jstring new_utf8_string(const char* str) {
-    jsize length = 0;
-    bool fastPath = true;
-    for (size_t i = 0;; ++i) {
-        char c = str[i];
-        if (c == 0) {
-            length = i;
-            break;
-        } else if (((unsigned char) c) >= 0xF0) {
-            fastPath = false;
+    for (; i < length; ++i) {
+        unsigned char c = str[i];
+        if (c == 0xC0 || c == 0xED) {
+            return i;
         }
     }
+    return length;
+}
+
+// Rewrites JNI modified UTF-8 as standard UTF-8 in place and returns the new length. Modified UTF-8 encodes U+0000 as
+// C0 80 and each supplementary character as the 3 byte encodings of its two surrogates. The standard encodings are
+// shorter in both cases so the result never overtakes the input. Unpaired surrogates are left as they are.
+static size_t modified_utf8_to_utf8(char* str, size_t length) {
+    size_t in = find_modified_utf8_sequence(str, length);
+    size_t out = in;
+    while (in < length) {
+        const unsigned char* s = (const unsigned char*) str + in;
+        size_t remaining = length - in;
+        if (s[0] == 0xC0 && remaining >= 2 && s[1] == 0x80) {
+            str[out++] = 0;
+            in += 2;
+        } else if (s[0] == 0xED && remaining >= 6 && (s[1] & 0xF0) == 0xA0 && s[3] == 0xED && (s[4] & 0xF0) == 0xB0) {
+            uint32_t high = ((s[1] & 0x0F) << 6) | (s[2] & 0x3F);
+            uint32_t low = ((s[4] & 0x0F) << 6) | (s[5] & 0x3F);
+            uint32_t code_point = 0x10000 + (high << 10) + low;
+            str[out++] = char(0xF0 | (code_point >> 18));
+            str[out++] = char(0x80 | ((code_point >> 12) & 0x3F));
+            str[out++] = char(0x80 | ((code_point >> 6) & 0x3F));
+            str[out++] = char(0x80 | (code_point & 0x3F));
+            in += 6;
+        } else {
+            str[out++] = str[in++];
+        }
 
-    if (fastPath) {
-        return g_env->NewStringUTF(str);
-    } else {
-        return new_slow_utf8_string(str, length);
+        size_t next = in + find_modified_utf8_sequence(str + in, length - in);
+        memmove(str + out, str + in, next - in);
+        out += next - in;
+        in = next;
     }
+    return out;
 }
 
+std::string to_std_string(jstring str) {
+    jsize length = get_string_length(str);
+    jsize utf_length = get_string_utf_length(str);
 
-jsize get_string_length(jstring str) {
-    return check_exception(g_env->GetStringLength(str));
+    // GetStringUTFRegion also writes a terminating null, which lands on the terminator std::string already has.
+    std::string result(size_t(utf_length), '\0');
+    get_string_utf_region(str, 0, length, &result[0]);
+
+    // Modified UTF-8 and UTF-8 only differ for characters encoded in more than one byte.
+    if (utf_length != length) {
+        result.resize(modified_utf8_to_utf8(&result[0], result.size()));
+    }
+    return result;
 }
 
-const jchar* get_string_chars(jstring str, jboolean* is_copy) {
-    return check_exception(g_env->GetStringChars(str, is_copy));
+std::u16string to_u16string(jstring str) {
+    jsize length = get_string_length(str);
+    std::u16string result(size_t(length), u'\0');
+    get_string_region(str, 0, length, (jchar*) &result[0]);
+    return result;
 }
 
-void release_string_chars(jstring str, const jchar* chars) {
-    g_env->ReleaseStringChars(str, chars);
-    check_exception();
+size_t to_utf8(jstring str, char* buffer, size_t capacity) {
+    jsize length = get_string_length(str);
+    size_t utf_length = size_t(get_string_utf_length(str));
+    if (capacity <= utf_length) {
+        return utf_length + 1;
+    }
+
+    get_string_utf_region(str, 0, length, buffer);
+    if (utf_length != size_t(length)) {
+        utf_length = modified_utf8_to_utf8(buffer, utf_length);
+    }
+    buffer[utf_length] = 0;
+    return utf_length;
 }
 
 template <>
 jarray new_primitive_array<jboolean>(jsize size) {
-    return check_exception(g_env->NewBooleanArray(size));
+    return check_exception(get_env()->NewBooleanArray(size));
 }
 
 template <>
 jarray new_primitive_array<jbyte>(jsize size) {
-    return check_exception(g_env->NewByteArray(size));
+    return check_exception(get_env()->NewByteArray(size));
 }
 
 template <>
 jarray new_primitive_array<jshort>(jsize size) {
-    return check_exception(g_env->NewShortArray(size));
+    return check_exception(get_env()->NewShortArray(size));
 }
 
 template <>
 jarray new_primitive_array<jint>(jsize size) {
-    return check_exception(g_env->NewIntArray(size));
+    return check_exception(get_env()->NewIntArray(size));
 }
 
 template <>
 jarray new_primitive_array<jlong>(jsize size) {
-    return check_exception(g_env->NewLongArray(size));
+    return check_exception(get_env()->NewLongArray(size));
 }
 
 template <>
 jarray new_primitive_array<jchar>(jsize size) {
-    return check_exception(g_env->NewCharArray(size));
+    return check_exception(get_env()->NewCharArray(size));
 }
 
 template <>
 jarray new_primitive_array<jfloat>(jsize size) {
-    return check_exception(g_env->NewFloatArray(size));
+    return check_exception(get_env()->NewFloatArray(size));
 }
 
 template <>
 jarray new_primitive_array<jdouble>(jsize size) {
-    return check_exception(g_env->NewDoubleArray(size));
+    return check_exception(get_env()->NewDoubleArray(size));
 }
 
 jarray new_object_array(jsize size, jclass element_class, jobject initial_element) {
-    return check_exception(g_env->NewObjectArray(size, element_class, initial_element));
-}
-
-jsize get_array_length(jarray array) {
-    return check_exception(g_env->GetArrayLength(array));
-}
-
-
-template <>
-jboolean get_array_element(jarray array, jsize idx) {
-    jboolean value;
-    g_env->GetBooleanArrayRegion((jbooleanArray) array, idx, 1, &value);
-    check_exception();
-    return value;
+    return check_exception(get_env()->NewObjectArray(size, element_class, initial_element));
 }
 
-template <>
-void set_array_element(jarray array, jsize idx, jboolean value) {
-    g_env->SetBooleanArrayRegion((jbooleanArray) array, idx, 1, &value);
-    check_exception();
-}
 
 template<>
 jboolean* get_array_elements(jarray array, jboolean* is_copy) {
-    return check_exception(g_env->GetBooleanArrayElements((jbooleanArray) array, is_copy));
+    return check_exception(get_env()->GetBooleanArrayElements((jbooleanArray) array, is_copy));
 }
 
 template <> void release_array_elements(jarray array, jboolean* elements, jint mode) {
-    g_env->ReleaseBooleanArrayElements((jbooleanArray) array, elements, mode);
+    get_env()->ReleaseBooleanArrayElements((jbooleanArray) array, elements, mode);
     check_exception();
 }
 
-template <>
-jbyte get_array_element(jarray array, jsize idx) {
-    jbyte value;
-    g_env->GetByteArrayRegion((jbyteArray) array, idx, 1, &value);
-    check_exception();
-    return value;
-}
-
-template <>
-void set_array_element(jarray array, jsize idx, jbyte value) {
-    g_env->SetByteArrayRegion((jbyteArray) array, idx, 1, &value);
-    check_exception();
-}
 
 template<>
 jbyte* get_array_elements(jarray array, jboolean* is_copy) {
-    return check_exception(g_env->GetByteArrayElements((jbyteArray) array, is_copy));
+    return check_exception(get_env()->GetByteArrayElements((jbyteArray) array, is_copy));
 }
 
 template <> void release_array_elements(jarray array, jbyte* elements, jint mode) {
-    g_env->ReleaseByteArrayElements((jbyteArray) array, elements, mode);
-    check_exception();
-}
-
-template <>
-jshort get_array_element(jarray array, jsize idx) {
-    jshort value;
-    g_env->GetShortArrayRegion((jshortArray) array, idx, 1, &value);
+    get_env()->ReleaseByteArrayElements((jbyteArray) array, elements, mode);
     check_exception();
-    return value;
 }
 
-template <>
-void set_array_element(jarray array, jsize idx, jshort value) {
-    g_env->SetShortArrayRegion((jshortArray) array, idx, 1, &value);
-    check_exception();
-}
 
 template<>
 jshort* get_array_elements(jarray array, jboolean* is_copy) {
-    return check_exception(g_env->GetShortArrayElements((jshortArray) array, is_copy));
+    return check_exception(get_env()->GetShortArrayElements((jshortArray) array, is_copy));
 }
 
 template <> void release_array_elements(jarray array, jshort* elements, jint mode) {
-    g_env->ReleaseShortArrayElements((jshortArray) array, elements, mode);
+    get_env()->ReleaseShortArrayElements((jshortArray) array, elements, mode);
     check_exception();
 }
 
-template <>
-jint get_array_element(jarray array, jsize idx) {
-    jint value;
-    g_env->GetIntArrayRegion((jintArray) array, idx, 1, &value);
-    check_exception();
-    return value;
-}
-
-template <>
-void set_array_element(jarray array, jsize idx, jint value) {
-    g_env->SetIntArrayRegion((jintArray) array, idx, 1, &value);
-    check_exception();
-}
 
 template<>
 jint* get_array_elements(jarray array, jboolean* is_copy) {
-    return check_exception(g_env->GetIntArrayElements((jintArray) array, is_copy));
+    return check_exception(get_env()->GetIntArrayElements((jintArray) array, is_copy));
 }
 
 template <> void release_array_elements(jarray array, jint* elements, jint mode) {
-    g_env->ReleaseIntArrayElements((jintArray) array, elements, mode);
-    check_exception();
-}
-
-template <>
-jlong get_array_element(jarray array, jsize idx) {
-    jlong value;
-    g_env->GetLongArrayRegion((jlongArray) array, idx, 1, &value);
+    get_env()->ReleaseIntArrayElements((jintArray) array, elements, mode);
     check_exception();
-    return value;
 }
 
-template <>
-void set_array_element(jarray array, jsize idx, jlong value) {
-    g_env->SetLongArrayRegion((jlongArray) array, idx, 1, &value);
-    check_exception();
-}
 
 template<>
 jlong* get_array_elements(jarray array, jboolean* is_copy) {
-    return check_exception(g_env->GetLongArrayElements((jlongArray) array, is_copy));
+    return check_exception(get_env()->GetLongArrayElements((jlongArray) array, is_copy));
 }
 
 template <> void release_array_elements(jarray array, jlong* elements, jint mode) {
-    g_env->ReleaseLongArrayElements((jlongArray) array, elements, mode);
-    check_exception();
-}
-
-template <>
-jchar get_array_element(jarray array, jsize idx) {
-    jchar value;
-    g_env->GetCharArrayRegion((jcharArray) array, idx, 1, &value);
+    get_env()->ReleaseLongArrayElements((jlongArray) array, elements, mode);
     check_exception();
-    return value;
 }
 
-template <>
-void set_array_element(jarray array, jsize idx, jchar value) {
-    g_env->SetCharArrayRegion((jcharArray) array, idx, 1, &value);
-    check_exception();
-}
 
 template<>
 jchar* get_array_elements(jarray array, jboolean* is_copy) {
-    return check_exception(g_env->GetCharArrayElements((jcharArray) array, is_copy));
+    return check_exception(get_env()->GetCharArrayElements((jcharArray) array, is_copy));
 }
 
 template <> void release_array_elements(jarray array, jchar* elements, jint mode) {
-    g_env->ReleaseCharArrayElements((jcharArray) array, elements, mode);
+    get_env()->ReleaseCharArrayElements((jcharArray) array, elements, mode);
     check_exception();
 }
 
-template <>
-jfloat get_array_element(jarray array, jsize idx) {
-    jfloat value;
-    g_env->GetFloatArrayRegion((jfloatArray) array, idx, 1, &value);
-    check_exception();
-    return value;
-}
-
-template <>
-void set_array_element(jarray array, jsize idx, jfloat value) {
-    g_env->SetFloatArrayRegion((jfloatArray) array, idx, 1, &value);
-    check_exception();
-}
 
 template<>
 jfloat* get_array_elements(jarray array, jboolean* is_copy) {
-    return check_exception(g_env->GetFloatArrayElements((jfloatArray) array, is_copy));
+    return check_exception(get_env()->GetFloatArrayElements((jfloatArray) array, is_copy));
 }
 
 template <> void release_array_elements(jarray array, jfloat* elements, jint mode) {
-    g_env->ReleaseFloatArrayElements((jfloatArray) array, elements, mode);
+    get_env()->ReleaseFloatArrayElements((jfloatArray) array, elements, mode);
     check_exception();
 }
 
-template <>
-jdouble get_array_element(jarray array, jsize idx) {
-    jdouble value;
-    g_env->GetDoubleArrayRegion((jdoubleArray) array, idx, 1, &value);
-    check_exception();
-    return value;
-}
-
-template <>
-void set_array_element(jarray array, jsize idx, jdouble value) {
-    g_env->SetDoubleArrayRegion((jdoubleArray) array, idx, 1, &value);
-    check_exception();
-}
 
 template<>
 jdouble* get_array_elements(jarray array, jboolean* is_copy) {
-    return check_exception(g_env->GetDoubleArrayElements((jdoubleArray) array, is_copy));
+    return check_exception(get_env()->GetDoubleArrayElements((jdoubleArray) array, is_copy));
 }
 
 template <> void release_array_elements(jarray array, jdouble* elements, jint mode) {
-    g_env->ReleaseDoubleArrayElements((jdoubleArray) array, elements, mode);
+    get_env()->ReleaseDoubleArrayElements((jdoubleArray) array, elements, mode);
     check_exception();
 }
 
-template <>
-jobject get_array_element(jarray array, jsize idx) {
-    return check_exception(g_env->GetObjectArrayElement((jobjectArray) array, idx));
-}
-
-template <>
-void set_array_element(jarray array, jsize idx, jobject value) {
-    g_env->SetObjectArrayElement((jobjectArray) array, idx, value);
-    check_exception();
-}
 
 void* get_primitive_array_critical(jarray array, jboolean* is_copy) {
-    void* ptr = g_env->GetPrimitiveArrayCritical(array, is_copy);
+    void* ptr = get_env()->GetPrimitiveArrayCritical(array, is_copy);
 
     // Must not call check_exception, ExceptionOccurred or any other JNI function before releasing aside from nesting
     // more getPrimitiveArrayCritical/releasePrimitiveArrayCritical pairs.
@@ -1228,21 +1356,84 @@ void* get_primitive_array_critical(jarray array, jboolean* is_copy) {
 }
 
 void release_primitive_array_critical(jarray array, void* elements, jint mode) {
-    g_env->ReleasePrimitiveArrayCritical(array, elements, mode);
+    get_env()->ReleasePrimitiveArrayCritical(array, elements, mode);
 }
 
-void push_local_frame(jint capacity) {
-    g_env->PushLocalFrame(capacity);
+
+void ensure_local_capacity(jint capacity) {
+    get_env()->EnsureLocalCapacity(capacity);
     check_exception();
 }
 
-jobject pop_local_frame(jobject result) {
-    return check_exception(g_env->PopLocalFrame(result));
+jobject new_direct_byte_buffer(void* address, jlong capacity) {
+    return check_exception(get_env()->NewDirectByteBuffer(address, capacity));
+}
+
+void* get_direct_buffer_address(jobject buffer) {
+    return check_exception(get_env()->GetDirectBufferAddress(buffer));
+}
+
+jlong get_direct_buffer_capacity(jobject buffer) {
+    return check_exception(get_env()->GetDirectBufferCapacity(buffer));
 }
 
 void register_natives(jclass clazz, const JNINativeMethod* methods, jint numMethods) {
-    g_env->RegisterNatives(clazz, methods, numMethods);
+    get_env()->RegisterNatives(clazz, methods, numMethods);
     check_exception();
 }
 
+// Bindings are only ever added to the front of these lists so they may be walked without locking.
+template <typename T>
+static void link_binding(std::atomic<T*>& head, T* binding, T** next) {
+    *next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(*next, binding, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+class_binding::class_binding(const char* name): name_(name), clazz_(nullptr) {
+    link_binding(g_class_bindings, this, &next_);
+}
+
+jclass class_binding::resolve() {
+    jclass clazz = class_cache::get(name_);
+    clazz_.store(clazz, std::memory_order_release);
+    return clazz;
+}
+
+method_binding::method_binding(class_binding& clazz, const char* name, const char* signature, bool is_static)
+    : clazz_(clazz), name_(name), signature_(signature), is_static_(is_static), id_(nullptr) {
+    link_binding(g_method_bindings, this, &next_);
+}
+
+jmethodID method_binding::resolve() {
+    jmethodID id = is_static_ ? get_static_method_id(clazz_.get(), name_, signature_)
+                              : get_method_id(clazz_.get(), name_, signature_);
+    id_.store(id, std::memory_order_release);
+    return id;
+}
+
+field_binding::field_binding(class_binding& clazz, const char* name, const char* signature, bool is_static)
+    : clazz_(clazz), name_(name), signature_(signature), is_static_(is_static), id_(nullptr) {
+    link_binding(g_field_bindings, this, &next_);
+}
+
+jfieldID field_binding::resolve() {
+    jfieldID id = is_static_ ? get_static_field_id(clazz_.get(), name_, signature_)
+                             : get_field_id(clazz_.get(), name_, signature_);
+    id_.store(id, std::memory_order_release);
+    return id;
+}
+
+void resolve_all_bindings() {
+    for (auto binding = g_class_bindings.load(std::memory_order_acquire); binding; binding = binding->next_) {
+        binding->get();
+    }
+    for (auto binding = g_method_bindings.load(std::memory_order_acquire); binding; binding = binding->next_) {
+        binding->get();
+    }
+    for (auto binding = g_field_bindings.load(std::memory_order_acquire); binding; binding = binding->next_) {
+        binding->get();
+    }
+}
+
 }  // namespace whatjni
@@ -0,0 +1,237 @@
+#include "whatjni/batch.h"
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace whatjni {
+
+namespace {
+
+struct method_info {
+    jint index;
+    std::string kinds;
+    jsize num_objects;  // including the receiver
+};
+
+std::mutex g_methods_mutex;
+std::unordered_map<jmethodID, method_info> g_methods;  // elements are never removed, so never move
+
+thread_local std::unordered_map<jmethodID, const method_info*> t_methods;
+
+jclass get_replayer_class() {
+    static jclass clazz = class_cache::get("whatjni/runtime/BatchReplayer");
+    return clazz;
+}
+
+const method_info& get_method_info(jclass clazz, jobject obj, jmethodID method) {
+    auto it = t_methods.find(method);
+    if (it != t_methods.end()) {
+        return *it->second;
+    }
+
+    const method_info* info = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(g_methods_mutex);
+        auto it = g_methods.find(method);
+        if (it != g_methods.end()) {
+            info = &it->second;
+        }
+    }
+
+    if (!info) {
+        static jmethodID register_method = get_static_method_id(get_replayer_class(), "register",
+                                                                "(Ljava/lang/reflect/Method;)I");
+        static jmethodID get_kinds_method = get_static_method_id(get_replayer_class(), "getKinds",
+                                                                 "(I)Ljava/lang/String;");
+
+        // Registered without holding the lock. Two threads registering the same method both get an index, which is
+        // harmless.
+        suspend_batch suspend;
+        jclass declaring_class = clazz ? clazz : get_object_class(obj);
+        jobject reflected = to_reflected_method(declaring_class, method, clazz != nullptr);
+        if (!clazz) {
+            delete_local_ref(declaring_class);
+        }
+        jint index = call_static_method<jint>(get_replayer_class(), register_method, reflected);
+        delete_local_ref(reflected);
+        jstring kinds = (jstring) call_static_method<jobject>(get_replayer_class(), get_kinds_method, index);
+
+        method_info registered = { index, to_std_string(kinds), obj ? 1 : 0 };
+        delete_local_ref(kinds);
+        for (char kind : registered.kinds) {
+            registered.num_objects += kind == 'L';
+        }
+
+        std::lock_guard<std::mutex> lock(g_methods_mutex);
+        info = &g_methods.emplace(method, std::move(registered)).first->second;
+    }
+
+    t_methods.emplace(method, info);
+    return *info;
+}
+
+template <typename T, typename U> jlong bits_of(U value) {
+    T bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+}  // namespace anonymous
+
+batch::batch(): uncaught_exceptions_(std::uncaught_exceptions()) {
+    outer_ = set_current_batch(this);
+    if (outer_) {
+        set_current_batch(outer_);
+    }
+}
+
+batch::~batch() noexcept(false) {
+    if (outer_) {
+        return;
+    }
+
+    struct cleanup {
+        batch* b;
+        ~cleanup() {
+            set_current_batch(nullptr);
+            if (b->objects_) {
+                delete_global_ref(b->objects_);
+            }
+        }
+    } cleanup = { this };
+
+    // Do not throw while unwinding.
+    if (std::uncaught_exceptions() == uncaught_exceptions_) {
+        flush();
+    }
+}
+
+void batch::flush() {
+    if (outer_) {
+        outer_->flush();
+        return;
+    }
+    receiver_ = nullptr;
+    if (methods_.empty()) {
+        return;
+    }
+
+    static jmethodID replay_method = get_static_method_id(get_replayer_class(), "replay",
+                                                          "(I[I[J[Ljava/lang/Object;)V");
+
+    suspend_batch suspend;
+    jsize count = jsize(methods_.size());
+    jarray methods = new_primitive_array<jint>(count);
+    set_array_region(methods, 0, count, methods_.data());
+    jarray primitives = new_primitive_array<jlong>(jsize(primitives_.size()));
+    set_array_region(primitives, 0, jsize(primitives_.size()), primitives_.data());
+
+    // Cleared first so that, if a replayed call throws, the calls after it are discarded rather than replayed again.
+    methods_.clear();
+    primitives_.clear();
+    num_objects_ = 0;
+
+    try {
+        call_static_method<void>(get_replayer_class(), replay_method, count, (jobject) methods, (jobject) primitives,
+                                 (jobject) objects_);
+    } catch (...) {
+        delete_local_ref(primitives);
+        delete_local_ref(methods);
+        throw;
+    }
+    delete_local_ref(primitives);
+    delete_local_ref(methods);
+}
+
+void batch::record(jclass clazz, jobject obj, jmethodID method, const jvalue* args) {
+    const method_info& info = get_method_info(clazz, obj, method);
+    if (jsize(methods_.size()) == capacity || num_objects_ + info.num_objects > capacity) {
+        flush();
+    }
+
+    if (!objects_) {
+        suspend_batch suspend;
+        jobject local = new_object_array(capacity, class_cache::get("java/lang/Object"), nullptr);
+        objects_ = (jobjectArray) new_global_ref(local);
+        delete_local_ref(local);
+        methods_.reserve(capacity);
+    }
+
+    // The replayer reuses the previous call's receiver for a method index recorded as its complement.
+    jint index = info.index;
+    if (obj) {
+        uint64_t deletions = get_num_global_ref_deletions();
+        if (obj == receiver_ && deletions == receiver_deletions_) {
+            index = ~index;
+        } else {
+            add_object(obj);
+            if (!entered_native_method_) {
+                receiver_ = obj;
+                receiver_deletions_ = deletions;
+            }
+        }
+    }
+    methods_.push_back(index);
+
+    for (size_t i = 0; i < info.kinds.size(); ++i) {
+        const jvalue& arg = args[i];
+        switch (info.kinds[i]) {
+        case 'Z':
+            primitives_.push_back(arg.z);
+            break;
+        case 'B':
+            primitives_.push_back(arg.b);
+            break;
+        case 'C':
+            primitives_.push_back(arg.c);
+            break;
+        case 'S':
+            primitives_.push_back(arg.s);
+            break;
+        case 'I':
+            primitives_.push_back(arg.i);
+            break;
+        case 'J':
+            primitives_.push_back(arg.j);
+            break;
+        case 'F':
+            primitives_.push_back(bits_of<int32_t>(arg.f));
+            break;
+        case 'D':
+            primitives_.push_back(bits_of<int64_t>(arg.d));
+            break;
+        default:
+            add_object(arg.l);
+            break;
+        }
+    }
+}
+
+void batch::add_object(jobject obj) {
+    set_array_element<jobject>(objects_, num_objects_++, obj);
+}
+
+void forget_batched_receiver(batch* b, jobject obj) noexcept {
+    if (!obj || obj == b->receiver_) {
+        b->receiver_ = nullptr;
+    }
+}
+
+void batch_entered_native_method(batch* b) {
+    b->receiver_ = nullptr;
+    b->entered_native_method_ = true;
+}
+
+void record_batched_call(batch* b, jclass clazz, jobject obj, jmethodID method, const jvalue* args) {
+    b->record(clazz, obj, method, args);
+}
+
+void flush_batch(batch* b) {
+    b->flush();
+}
+
+}  // namespace whatjni
@@ -0,0 +1,53 @@
+#include "whatjni/callback.h"
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+
+namespace whatjni {
+
+namespace {
+
+void JNICALL invoke(JNIEnv* env, jclass, jlong handle, jobject result, jthrowable error) {
+    initialize_thread(env);
+
+    std::unique_ptr<native_callback_function> function((native_callback_function*) intptr_t(handle));
+    try {
+        (*function)(result, error);
+    } catch (const jvm_exception& e) {
+        env->Throw(e.get_throwable());
+    } catch (const std::exception& e) {
+        env->ThrowNew(class_cache::get("java/lang/RuntimeException"), e.what());
+    } catch (...) {
+        env->ThrowNew(class_cache::get("java/lang/RuntimeException"), "Native callback threw unknown exception");
+    }
+}
+
+jclass get_callback_class() {
+    static jclass clazz = [] {
+        jclass clazz = class_cache::get("whatjni/runtime/NativeCallback");
+        JNINativeMethod methods[] = {
+            { (char*) "invoke", (char*) "(JLjava/lang/Object;Ljava/lang/Throwable;)V", (void*) &invoke },
+        };
+        register_natives(clazz, methods, 1);
+        return clazz;
+    }();
+    return clazz;
+}
+
+}  // namespace anonymous
+
+jobject new_native_callback(native_callback_function function) {
+    static jclass clazz = get_callback_class();
+    static jmethodID constructor = get_method_id(clazz, "<init>", "(J)V");
+
+    auto handle = new native_callback_function(std::move(function));
+    try {
+        return new_object(clazz, constructor, jlong(intptr_t(handle)));
+    } catch (...) {
+        delete handle;
+        throw;
+    }
+}
+
+}  // namespace whatjni
@@ -0,0 +1,39 @@
+#include "whatjni/completable_future.h"
+#include "whatjni/callback.h"
+
+#include <memory>
+
+namespace whatjni {
+
+static void complete(const completion_function& function, jobject result, jthrowable error) {
+    if (error) {
+        function(nullptr, std::make_exception_ptr(jvm_exception(new_local_ref(error))));
+    } else {
+        function(result, nullptr);
+    }
+}
+
+void when_complete(jobject future, executor* ex, completion_function function) {
+    static jmethodID when_complete_method = get_method_id(class_cache::get("java/util/concurrent/CompletableFuture"),
+        "whenComplete", "(Ljava/util/function/BiConsumer;)Ljava/util/concurrent/CompletableFuture;");
+
+    jobject callback = new_native_callback([ex, function = std::move(function)](jobject result, jthrowable error) {
+        if (!ex) {
+            complete(function, result, error);
+            return;
+        }
+
+        // Local refs cannot cross threads.
+        std::shared_ptr<_jobject> global_result(result ? new_global_ref(result) : nullptr, delete_global_ref);
+        std::shared_ptr<_jobject> global_error(error ? new_global_ref(error) : nullptr, delete_global_ref);
+        ex->submit([function, global_result, global_error] {
+            complete(function, global_result.get(), (jthrowable) global_error.get());
+        });
+    });
+
+    jobject stage = call_method<jobject>(future, when_complete_method, callback);
+    delete_local_ref(stage);
+    delete_local_ref(callback);
+}
+
+}  // namespace whatjni
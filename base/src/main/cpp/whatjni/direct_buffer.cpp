@@ -0,0 +1,33 @@
+#include "whatjni/direct_buffer.h"
+
+namespace whatjni {
+
+direct_buffer::direct_buffer(const ref<java::nio::ByteBuffer>& buffer): buffer_(buffer) {
+    jobject obj = (jobject) buffer_.operator->();
+    data_ = (std::byte*) get_direct_buffer_address(obj);
+    if (!data_) {
+        throw jvm_error(JNI_EINVAL);
+    }
+    size_ = size_t(get_direct_buffer_capacity(obj));
+}
+
+direct_buffer direct_buffer::wrap(void* data, size_t size) {
+    static jclass byte_order_class = class_cache::get("java/nio/ByteOrder");
+    static jmethodID native_order_method = get_static_method_id(byte_order_class, "nativeOrder",
+                                                                "()Ljava/nio/ByteOrder;");
+    static jmethodID order_method = get_method_id(class_cache::get("java/nio/ByteBuffer"), "order",
+                                                  "(Ljava/nio/ByteOrder;)Ljava/nio/ByteBuffer;");
+
+    ref<java::nio::ByteBuffer> buffer(new_direct_byte_buffer(data, jlong(size)), own_ref);
+    ref<java::lang::Object> native_order(call_static_method<jobject>(byte_order_class, native_order_method), own_ref);
+    delete_local_ref(call_method<jobject>((jobject) buffer.operator->(), order_method,
+                                          (jobject) native_order.operator->()));
+
+    direct_buffer result;
+    result.buffer_ = std::move(buffer);
+    result.data_ = (std::byte*) data;
+    result.size_ = size;
+    return result;
+}
+
+}  // namespace whatjni
@@ -0,0 +1,226 @@
+#include "whatjni/executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace whatjni {
+
+namespace {
+
+const size_t QUEUE_CAPACITY = 1024;  // power of two
+const jint TASK_FRAME_CAPACITY = 16;
+
+// Bounded multi-producer multi-consumer queue after Dmitry Vyukov. Each cell's sequence number says whether it is ready
+// to be written or read on the current lap, so producers and consumers each claim a cell with a single CAS.
+class task_queue {
+    struct cell {
+        std::atomic<size_t> sequence;
+        executor::task* task;
+    };
+
+    std::unique_ptr<cell[]> cells_;
+    alignas(64) std::atomic<size_t> push_pos_;
+    alignas(64) std::atomic<size_t> pop_pos_;
+
+public:
+    task_queue(): cells_(new cell[QUEUE_CAPACITY]), push_pos_(0), pop_pos_(0) {
+        for (size_t i = 0; i < QUEUE_CAPACITY; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(executor::task* task) {
+        size_t pos = push_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell& c = cells_[pos & (QUEUE_CAPACITY - 1)];
+            size_t sequence = c.sequence.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+            if (diff == 0) {
+                if (push_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.task = task;
+                    c.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = push_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    executor::task* try_pop() {
+        size_t pos = pop_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell& c = cells_[pos & (QUEUE_CAPACITY - 1)];
+            size_t sequence = c.sequence.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(sequence) - intptr_t(pos + 1);
+            if (diff == 0) {
+                if (pop_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    executor::task* task = c.task;
+                    c.sequence.store(pos + QUEUE_CAPACITY, std::memory_order_release);
+                    return task;
+                }
+            } else if (diff < 0) {
+                return nullptr;  // empty
+            } else {
+                pos = pop_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+}  // namespace anonymous
+
+struct executor::impl {
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next_queue{0};
+
+    // Tasks that did not fit in any queue.
+    std::mutex overflow_mutex;
+    std::deque<task*> overflow;
+
+    // Counts tasks submitted but not yet dequeued. Submitters increment it before checking for sleepers and workers
+    // register as sleepers before checking it, so a task cannot be left queued while every worker sleeps. A worker that
+    // wakes before the submitter has finished pushing spins until the task is visible.
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> sleepers{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+
+    // The executor whose worker is the current thread, if any, so tasks submitted by tasks go to the worker's own
+    // queue.
+    static thread_local impl* current;
+    static thread_local size_t current_index;
+
+    void push(task* t);
+    task* pop(size_t index);
+    void run_worker(size_t index, attach_options options);
+};
+
+thread_local executor::impl* executor::impl::current;
+thread_local size_t executor::impl::current_index;
+
+void executor::impl::push(task* t) {
+    // Counted before the task is visible, so a worker that dequeues it never sees the count go below zero.
+    pending.fetch_add(1);
+
+    size_t n = queues.size();
+    size_t start = current == this ? current_index : next_queue.fetch_add(1, std::memory_order_relaxed);
+    bool pushed = false;
+    for (size_t i = 0; i < n && !pushed; ++i) {
+        pushed = queues[(start + i) % n]->try_push(t);
+    }
+
+    if (!pushed) {
+        std::lock_guard<std::mutex> lock(overflow_mutex);
+        overflow.push_back(t);
+    }
+
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        wake.notify_one();
+    }
+}
+
+executor::task* executor::impl::pop(size_t index) {
+    // Own queue first, then steal from the others, starting with the next so thieves spread out.
+    size_t n = queues.size();
+    for (size_t i = 0; i < n; ++i) {
+        if (task* t = queues[(index + i) % n]->try_pop()) {
+            return t;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(overflow_mutex);
+    if (overflow.empty()) {
+        return nullptr;
+    }
+    task* t = overflow.front();
+    overflow.pop_front();
+    return t;
+}
+
+void executor::impl::run_worker(size_t index, attach_options options) {
+    if (!options.name.empty()) {
+        options.name += "-" + std::to_string(index);
+    }
+    scoped_attach attach(options);
+
+    current = this;
+    current_index = index;
+
+    for (;;) {
+        task* t = pop(index);
+        if (t) {
+            pending.fetch_sub(1);
+            try {
+                scoped_local_frame frame(TASK_FRAME_CAPACITY);
+                t->run();
+            } catch (...) {
+            }
+            delete t;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleepers.fetch_add(1);
+        wake.wait(lock, [this] { return pending.load() > 0 || stopping.load(); });
+        sleepers.fetch_sub(1);
+        if (stopping.load() && pending.load() == 0) {
+            break;
+        }
+    }
+
+    current = nullptr;
+}
+
+executor::executor(size_t num_threads, const attach_options& options): impl_(new impl) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < num_threads; ++i) {
+        impl_->queues.emplace_back(new task_queue);
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        impl_->threads.emplace_back(&impl::run_worker, impl_.get(), i, options);
+    }
+}
+
+executor::~executor() {
+    {
+        std::lock_guard<std::mutex> lock(impl_->sleep_mutex);
+        impl_->stopping.store(true);
+    }
+    impl_->wake.notify_all();
+
+    for (auto& thread : impl_->threads) {
+        thread.join();
+    }
+}
+
+size_t executor::get_num_threads() const {
+    return impl_->threads.size();
+}
+
+void executor::post(std::unique_ptr<task> t) {
+    impl_->push(t.release());
+}
+
+attach_options executor::default_attach_options() {
+    attach_options options;
+    options.daemon = true;
+    options.name = "whatjni-executor";
+    return options;
+}
+
+}  // namespace whatjni
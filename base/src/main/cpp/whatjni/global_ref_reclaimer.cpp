@@ -0,0 +1,44 @@
+#include "whatjni/global_ref_reclaimer.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace whatjni {
+
+struct global_ref_reclaimer::impl {
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread;
+
+    void run(std::chrono::milliseconds interval) {
+        attach_options options;
+        options.daemon = true;
+        options.name = "whatjni-global-ref-reclaimer";
+        scoped_attach attach(options);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            wake.wait_for(lock, interval, [this] { return stopping; });
+            lock.unlock();
+            delete_queued_global_refs();
+            lock.lock();
+        }
+    }
+};
+
+global_ref_reclaimer::global_ref_reclaimer(std::chrono::milliseconds interval): impl_(new impl) {
+    impl_->thread = std::thread(&impl::run, impl_.get(), interval);
+}
+
+global_ref_reclaimer::~global_ref_reclaimer() {
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->stopping = true;
+    }
+    impl_->wake.notify_one();
+    impl_->thread.join();
+}
+
+}  // namespace whatjni
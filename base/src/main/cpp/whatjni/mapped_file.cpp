@@ -0,0 +1,230 @@
+#include "whatjni/mapped_file.h"
+
+#include <cerrno>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace whatjni {
+
+namespace {
+
+struct retired_mapping {
+    std::byte* data;
+    size_t size;
+    jobject root;
+};
+
+std::mutex g_retired_mutex;
+std::vector<retired_mapping> g_retired;
+
+// NewDirectByteBuffer needs an address even for an empty file, which cannot be mapped.
+std::byte g_empty;
+
+#ifdef _WIN32
+
+[[noreturn]] void throw_last_error(const char* what) {
+    throw std::system_error(GetLastError(), std::system_category(), what);
+}
+
+std::byte* map(const std::string& path, bool writable, size_t* size) {
+    HANDLE file = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw_last_error("CreateFile");
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        DWORD error = GetLastError();
+        CloseHandle(file);
+        throw std::system_error(error, std::system_category(), "GetFileSizeEx");
+    }
+
+    *size = size_t(file_size.QuadPart);
+    if (*size == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    // The view keeps the file and the mapping object open after their handles are closed.
+    HANDLE mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+    DWORD error = GetLastError();
+    CloseHandle(file);
+    if (!mapping) {
+        throw std::system_error(error, std::system_category(), "CreateFileMapping");
+    }
+
+    void* data = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+    error = GetLastError();
+    CloseHandle(mapping);
+    if (!data) {
+        throw std::system_error(error, std::system_category(), "MapViewOfFile");
+    }
+
+    return (std::byte*) data;
+}
+
+void unmap(std::byte* data, size_t) {
+    UnmapViewOfFile(data);
+}
+
+void flush_mapping(std::byte* data, size_t size) {
+    if (!FlushViewOfFile(data, size)) {
+        throw_last_error("FlushViewOfFile");
+    }
+}
+
+#else  // assume POSIX
+
+[[noreturn]] void throw_errno(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+std::byte* map(const std::string& path, bool writable, size_t* size) {
+    int fd = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        throw_errno("open");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "fstat");
+    }
+
+    *size = size_t(st.st_size);
+    if (*size == 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    // The mapping keeps the file open after the descriptor is closed.
+    void* data = mmap(nullptr, *size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::system_error(error, std::generic_category(), "mmap");
+    }
+
+    return (std::byte*) data;
+}
+
+void unmap(std::byte* data, size_t size) {
+    munmap(data, size);
+}
+
+void flush_mapping(std::byte* data, size_t size) {
+    if (msync(data, size, MS_SYNC) != 0) {
+        throw_errno("msync");
+    }
+}
+
+#endif  // _WIN32
+
+}  // namespace anonymous
+
+mapped_file::mapped_file(const std::string& path, mode access): writable_(access == read_write) {
+    reclaim();
+    data_ = map(path, writable_, &size_);
+}
+
+mapped_file::~mapped_file() {
+    close();
+}
+
+mapped_file::mapped_file(mapped_file&& rhs)
+    : data_(rhs.data_), size_(rhs.size_), writable_(rhs.writable_), buffer_(std::move(rhs.buffer_)), root_(rhs.root_) {
+    rhs.data_ = nullptr;
+    rhs.size_ = 0;
+    rhs.root_ = nullptr;
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& rhs) {
+    if (this != &rhs) {
+        close();
+        data_ = rhs.data_;
+        size_ = rhs.size_;
+        writable_ = rhs.writable_;
+        buffer_ = std::move(rhs.buffer_);
+        root_ = rhs.root_;
+        rhs.data_ = nullptr;
+        rhs.size_ = 0;
+        rhs.root_ = nullptr;
+    }
+    return *this;
+}
+
+const ref<java::nio::ByteBuffer>& mapped_file::get_buffer() {
+    if (!buffer_) {
+        static jmethodID as_read_only_buffer_method = get_method_id(class_cache::get("java/nio/ByteBuffer"),
+                                                                    "asReadOnlyBuffer", "()Ljava/nio/ByteBuffer;");
+
+        direct_buffer root = direct_buffer::wrap(data_ ? data_ : &g_empty, size_);
+        jobject root_obj = (jobject) root.get_buffer().operator->();
+        root_ = new_weak_global_ref(root_obj);
+
+        if (writable_) {
+            buffer_ = root.get_buffer();
+        } else {
+            // The read-only view references the root buffer, so the root stays reachable as long as the view does.
+            ref<java::nio::ByteBuffer> view(call_method<jobject>(root_obj, as_read_only_buffer_method), own_ref);
+            buffer_ = view;
+        }
+    }
+    return buffer_;
+}
+
+void mapped_file::flush() {
+    if (data_ && writable_) {
+        flush_mapping(data_, size_);
+    }
+}
+
+void mapped_file::close() {
+    buffer_ = nullptr;
+
+    if (root_) {
+        if (data_) {
+            std::lock_guard<std::mutex> lock(g_retired_mutex);
+            g_retired.push_back(retired_mapping{ data_, size_, root_ });
+        } else {
+            delete_weak_global_ref(root_);
+        }
+    } else if (data_) {
+        unmap(data_, size_);
+    }
+
+    data_ = nullptr;
+    size_ = 0;
+    root_ = nullptr;
+
+    reclaim();
+}
+
+size_t mapped_file::reclaim() {
+    std::lock_guard<std::mutex> lock(g_retired_mutex);
+    auto it = g_retired.begin();
+    while (it != g_retired.end()) {
+        if (is_same_object(it->root, nullptr)) {
+            unmap(it->data, it->size);
+            delete_weak_global_ref(it->root);
+            it = g_retired.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return g_retired.size();
+}
+
+}  // namespace whatjni
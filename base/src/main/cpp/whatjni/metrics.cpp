@@ -0,0 +1,206 @@
+#include "whatjni/metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace whatjni {
+
+namespace {
+
+const int SUB_BUCKET_BITS = 3;
+const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+const int MAX_EXPONENT = binding_metrics::NUM_BUCKETS / SUB_BUCKETS + SUB_BUCKET_BITS - 2;
+
+// Never destroyed, so bindings with static storage duration may unregister during static destruction.
+struct registry {
+    std::mutex mutex;
+    std::vector<binding_metrics*> metrics;
+};
+
+registry& get_registry() {
+    static registry* r = new registry;
+    return *r;
+}
+
+int get_exponent(uint64_t value) {
+    int exponent = 0;
+    while (value >>= 1) {
+        ++exponent;
+    }
+    return exponent;
+}
+
+// Values below SUB_BUCKETS each have a bucket. Above that, the top SUB_BUCKET_BITS bits after the leading one select
+// one of SUB_BUCKETS buckets for that power of two.
+int get_bucket_index(uint64_t nanos) {
+    if (nanos < SUB_BUCKETS) {
+        return int(nanos);
+    }
+
+    int exponent = get_exponent(nanos);
+    if (exponent > MAX_EXPONENT) {
+        return binding_metrics::NUM_BUCKETS - 1;
+    }
+
+    int sub_bucket = int((nanos >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t get_bucket_upper_bound(int index) {
+    if (index < SUB_BUCKETS) {
+        return uint64_t(index + 1);
+    }
+    if (index == binding_metrics::NUM_BUCKETS - 1) {
+        return UINT64_MAX;  // also holds anything longer
+    }
+
+    int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    uint64_t sub_bucket = uint64_t(index % SUB_BUCKETS);
+    return (SUB_BUCKETS + sub_bucket + 1) << (exponent - SUB_BUCKET_BITS);
+}
+
+uint64_t get_percentile(const binding_metrics_snapshot& snapshot, double percentile) {
+    uint64_t target = uint64_t(snapshot.calls * percentile / 100);
+    uint64_t count = 0;
+    for (const latency_bucket& bucket : snapshot.buckets) {
+        count += bucket.count;
+        if (count > target) {
+            return std::min(bucket.upper_bound_nanos, snapshot.max_nanos);
+        }
+    }
+    return snapshot.max_nanos;
+}
+
+void write_label_value(std::ostream& out, const char* s) {
+    out << '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            out << '\\' << *s;
+        } else if (*s == '\n') {
+            out << "\\n";
+        } else {
+            out << *s;
+        }
+    }
+    out << '"';
+}
+
+void write_labels(std::ostream& out, const call_site& site, const char* quantile = nullptr) {
+    out << "{class=";
+    write_label_value(out, site.class_name);
+    out << ",member=";
+    write_label_value(out, site.name);
+    out << ",descriptor=";
+    write_label_value(out, site.descriptor);
+    out << ",op=\"" << get_trace_op_name(site.op) << '"';
+    if (quantile) {
+        out << ",quantile=\"" << quantile << '"';
+    }
+    out << '}';
+}
+
+void write_seconds(std::ostream& out, uint64_t nanos) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.9g", nanos / 1e9);
+    out << buffer;
+}
+
+}  // namespace anonymous
+
+void register_binding_metrics(binding_metrics* metrics) {
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.metrics.push_back(metrics);
+}
+
+void unregister_binding_metrics(binding_metrics* metrics) {
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.metrics.erase(std::remove(r.metrics.begin(), r.metrics.end(), metrics), r.metrics.end());
+}
+
+void record_binding_call(binding_metrics* metrics, uint64_t nanos) {
+    metrics->total_nanos.fetch_add(nanos, std::memory_order_relaxed);
+    metrics->buckets[get_bucket_index(nanos)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = metrics->max_nanos.load(std::memory_order_relaxed);
+    while (nanos > max && !metrics->max_nanos.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {
+    }
+}
+
+std::vector<binding_metrics_snapshot> metrics_snapshot() {
+    std::vector<binding_metrics_snapshot> result;
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    result.reserve(r.metrics.size());
+
+    for (binding_metrics* metrics : r.metrics) {
+        binding_metrics_snapshot snapshot;
+        snapshot.site = metrics->site;
+        snapshot.total_nanos = metrics->total_nanos.load(std::memory_order_relaxed);
+        snapshot.max_nanos = metrics->max_nanos.load(std::memory_order_relaxed);
+
+        for (int i = 0; i < binding_metrics::NUM_BUCKETS; ++i) {
+            uint64_t count = metrics->buckets[i].load(std::memory_order_relaxed);
+            if (count) {
+                snapshot.buckets.push_back(latency_bucket{ get_bucket_upper_bound(i), count });
+                snapshot.calls += count;
+            }
+        }
+
+        if (snapshot.calls == 0) {
+            continue;
+        }
+
+        snapshot.p50_nanos = get_percentile(snapshot, 50);
+        snapshot.p90_nanos = get_percentile(snapshot, 90);
+        snapshot.p99_nanos = get_percentile(snapshot, 99);
+        snapshot.p999_nanos = get_percentile(snapshot, 99.9);
+        result.push_back(std::move(snapshot));
+    }
+
+    return result;
+}
+
+void write_metrics(std::ostream& out) {
+    auto snapshots = metrics_snapshot();
+
+    out << "# HELP whatjni_binding_calls_total Calls through a generated JNI binding.\n";
+    out << "# TYPE whatjni_binding_calls_total counter\n";
+    for (auto& snapshot : snapshots) {
+        out << "whatjni_binding_calls_total";
+        write_labels(out, snapshot.site);
+        out << ' ' << snapshot.calls << '\n';
+    }
+
+    out << "# HELP whatjni_binding_latency_seconds Latency of calls through a generated JNI binding.\n";
+    out << "# TYPE whatjni_binding_latency_seconds summary\n";
+    for (auto& snapshot : snapshots) {
+        const std::pair<const char*, uint64_t> quantiles[] = {
+            { "0.5", snapshot.p50_nanos },
+            { "0.9", snapshot.p90_nanos },
+            { "0.99", snapshot.p99_nanos },
+            { "0.999", snapshot.p999_nanos },
+        };
+        for (auto& quantile : quantiles) {
+            out << "whatjni_binding_latency_seconds";
+            write_labels(out, snapshot.site, quantile.first);
+            out << ' ';
+            write_seconds(out, quantile.second);
+            out << '\n';
+        }
+
+        out << "whatjni_binding_latency_seconds_sum";
+        write_labels(out, snapshot.site);
+        out << ' ';
+        write_seconds(out, snapshot.total_nanos);
+        out << "\nwhatjni_binding_latency_seconds_count";
+        write_labels(out, snapshot.site);
+        out << ' ' << snapshot.calls << '\n';
+    }
+}
+
+}  // namespace whatjni
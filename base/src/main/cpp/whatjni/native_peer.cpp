@@ -0,0 +1,182 @@
+#include "whatjni/native_peer.h"
+#include "whatjni/batch.h"
+#include "whatjni/callback.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+
+namespace whatjni {
+
+namespace {
+
+const int CHUNK_BITS = 12;
+const uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+const uint32_t MAX_CHUNKS = 1 << 12;
+const uint32_t NO_SLOT = UINT32_MAX;
+
+// A slot's generation is odd while it holds a peer and even while it is free, so a free slot never matches a handle.
+struct peer_slot {
+    std::atomic<uint32_t> generation{0};
+    std::atomic<void*> peer{nullptr};
+    std::atomic<const std::type_info*> type{&typeid(void)};
+    native_peer_deleter deleter = nullptr;  // guarded by g_mutex
+    uint32_t next_free = NO_SLOT;           // guarded by g_mutex
+};
+
+// Slots are allocated a chunk at a time and never freed, so finding a peer needs no lock.
+std::atomic<peer_slot*> g_chunks[MAX_CHUNKS];
+
+std::mutex g_mutex;
+uint32_t g_num_slots;
+uint32_t g_first_free = NO_SLOT;
+size_t g_num_peers;
+
+// The low half of a handle is one more than the slot's index, so no handle is zero; the high half is its generation.
+jlong make_handle(uint32_t index, uint32_t generation) {
+    return jlong((uint64_t(generation) << 32) | (uint64_t(index) + 1));
+}
+
+uint32_t get_index(jlong handle) {
+    return uint32_t(uint64_t(handle)) - 1;
+}
+
+uint32_t get_generation(jlong handle) {
+    return uint32_t(uint64_t(handle) >> 32);
+}
+
+peer_slot* get_slot(uint32_t index) {
+    if (index >= CHUNK_SIZE * MAX_CHUNKS) {
+        return nullptr;
+    }
+    peer_slot* chunk = g_chunks[index >> CHUNK_BITS].load(std::memory_order_acquire);
+    return chunk ? &chunk[index & (CHUNK_SIZE - 1)] : nullptr;
+}
+
+}  // namespace anonymous
+
+jlong insert_native_peer(void* peer, const std::type_info& type, native_peer_deleter deleter) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    uint32_t index = g_first_free;
+    if (index != NO_SLOT) {
+        g_first_free = get_slot(index)->next_free;
+    } else {
+        index = g_num_slots;
+        if (index % CHUNK_SIZE == 0) {
+            if (index >= CHUNK_SIZE * MAX_CHUNKS) {
+                throw std::length_error("Too many native peers");
+            }
+            g_chunks[index >> CHUNK_BITS].store(new peer_slot[CHUNK_SIZE], std::memory_order_release);
+        }
+        ++g_num_slots;
+    }
+
+    // Pairs with the fence in find_native_peer(), which then sees the generation erase_native_peer() left, were it to
+    // read the new peer under a stale handle.
+    peer_slot* slot = get_slot(index);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->peer.store(peer, std::memory_order_relaxed);
+    slot->type.store(&type, std::memory_order_relaxed);
+    slot->deleter = deleter;
+
+    uint32_t generation = slot->generation.load(std::memory_order_relaxed) + 1;
+    slot->generation.store(generation, std::memory_order_release);
+
+    ++g_num_peers;
+    return make_handle(index, generation);
+}
+
+void* find_native_peer(jlong handle, const std::type_info& type) {
+    uint32_t generation = get_generation(handle);
+    peer_slot* slot = get_slot(get_index(handle));
+    if (!slot || slot->generation.load(std::memory_order_acquire) != generation) {
+        return nullptr;
+    }
+
+    const std::type_info* slot_type = slot->type.load(std::memory_order_relaxed);
+    void* peer = slot->peer.load(std::memory_order_relaxed);
+
+    // Like a seqlock: if the slot was erased, and perhaps reused, while its type and peer were read, they may belong
+    // to another peer.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->generation.load(std::memory_order_relaxed) != generation) {
+        return nullptr;
+    }
+
+    // type_info objects may be duplicated across shared libraries, so compare them when the addresses differ.
+    if (slot_type != &type && *slot_type != type) {
+        return nullptr;
+    }
+    return peer;
+}
+
+bool erase_native_peer(jlong handle) {
+    void* peer;
+    native_peer_deleter deleter;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+
+        uint32_t index = get_index(handle);
+        uint32_t generation = get_generation(handle);
+        peer_slot* slot = get_slot(index);
+        if (!slot || slot->generation.load(std::memory_order_relaxed) != generation) {
+            return false;
+        }
+
+        peer = slot->peer.load(std::memory_order_relaxed);
+        deleter = slot->deleter;
+        slot->generation.store(generation + 1, std::memory_order_release);
+
+        slot->next_free = g_first_free;
+        g_first_free = index;
+        --g_num_peers;
+    }
+
+    // Outside the lock, since destroying a peer may destroy others.
+    deleter(peer);
+    return true;
+}
+
+size_t get_num_native_peers() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_num_peers;
+}
+
+void attach_native_peer(jobject obj, jfieldID field, jlong handle) {
+    jlong previous;
+    try {
+        static jclass cleaner_class = class_cache::get("whatjni/runtime/PeerCleaner");
+        static jmethodID register_method = get_static_method_id(cleaner_class, "register",
+                                                                "(Ljava/lang/Object;Ljava/lang/Runnable;)V");
+
+        // If destroy_native_peer() gets there first, the handle's generation no longer matches and this does nothing.
+        std::unique_ptr<_jobject, void (*)(jobject)> action(new_native_callback([handle](jobject, jthrowable) {
+            erase_native_peer(handle);
+        }), delete_local_ref);
+        // Not recorded by a batch, which might be discarded after the handle is stored.
+        suspend_batch suspend;
+        call_static_method<void>(cleaner_class, register_method, obj, action.get());
+
+        previous = get_field<jlong>(obj, field);
+        set_field<jlong>(obj, field, handle);
+    } catch (...) {
+        erase_native_peer(handle);
+        throw;
+    }
+
+    if (previous != handle) {
+        erase_native_peer(previous);
+    }
+}
+
+void destroy_native_peer(jobject obj, jfieldID field) {
+    jlong handle = get_field<jlong>(obj, field);
+    if (handle) {
+        set_field<jlong>(obj, field, 0);
+        erase_native_peer(handle);
+    }
+}
+
+}  // namespace whatjni
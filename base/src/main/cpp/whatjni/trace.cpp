@@ -0,0 +1,247 @@
+#include "whatjni/trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+    #ifdef __linux__
+        #include <sys/syscall.h>
+    #endif
+#endif
+
+namespace whatjni {
+
+#ifdef WHATJNI_INLINE
+std::atomic<bool> g_tracing;
+#else
+static std::atomic<bool> g_tracing;
+
+bool is_tracing() {
+    return g_tracing.load(std::memory_order_relaxed);
+}
+#endif
+
+namespace {
+
+// Each event is guarded by a sequence number, like a seqlock: zero while the owning thread writes it, otherwise one
+// more than the event's index in the buffer. A reader that sees the same nonzero sequence before and after reading
+// the event read it whole.
+struct trace_event {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const call_site*> site{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+};
+
+struct trace_buffer {
+    uint64_t thread_id;
+    size_t capacity;
+    std::unique_ptr<trace_event[]> events;
+    std::atomic<uint64_t> head{0};   // written only by the owning thread
+    std::atomic<uint64_t> first{0};  // events before this one were discarded
+    std::atomic<bool> exited{false};
+
+    trace_buffer(uint64_t thread_id, size_t capacity)
+        : thread_id(thread_id), capacity(capacity), events(new trace_event[capacity]) {
+    }
+};
+
+std::mutex g_buffers_mutex;
+std::vector<std::unique_ptr<trace_buffer>> g_buffers;
+std::atomic<size_t> g_events_per_thread{65536};
+
+uint64_t get_os_thread_id() {
+#if defined(_WIN32)
+    return GetCurrentThreadId();
+#elif defined(__linux__)
+    return uint64_t(syscall(SYS_gettid));
+#elif defined(__APPLE__)
+    uint64_t id;
+    pthread_threadid_np(nullptr, &id);
+    return id;
+#else
+    return std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+}
+
+uint64_t get_process_id() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return uint64_t(getpid());
+#endif
+}
+
+// Marks the thread's buffer so clear_trace() may free it once the thread has exited.
+struct trace_buffer_owner {
+    trace_buffer* buffer = nullptr;
+    ~trace_buffer_owner() {
+        if (buffer) {
+            buffer->exited.store(true);
+        }
+    }
+};
+
+thread_local trace_buffer_owner t_trace_buffer;
+
+trace_buffer* get_thread_buffer() {
+    trace_buffer* buffer = t_trace_buffer.buffer;
+    if (!buffer) {
+        std::unique_ptr<trace_buffer> created(new trace_buffer(get_os_thread_id(), g_events_per_thread.load()));
+        buffer = created.get();
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        g_buffers.push_back(std::move(created));
+        t_trace_buffer.buffer = buffer;
+    }
+    return buffer;
+}
+
+// Java names cannot contain quotes or backslashes but descriptors are not checked here, so escape anyway.
+void write_json_string(std::ostream& out, const char* s) {
+    out << '"';
+    for (; *s; ++s) {
+        char c = *s;
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if ((unsigned char) c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void write_micros(std::ostream& out, uint64_t nanos) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%llu.%03u", (unsigned long long) (nanos / 1000), unsigned(nanos % 1000));
+    out << buffer;
+}
+
+struct copied_event {
+    const call_site* site;
+    uint64_t start;
+    uint64_t end;
+};
+
+void copy_events(const trace_buffer& buffer, std::vector<copied_event>* events) {
+    uint64_t head = buffer.head.load(std::memory_order_acquire);
+    uint64_t first = std::max(buffer.first.load(), head > buffer.capacity ? head - buffer.capacity : 0);
+    for (uint64_t i = first; i < head; ++i) {
+        const trace_event& event = buffer.events[i % buffer.capacity];
+        uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+        copied_event copied = {
+            event.site.load(std::memory_order_relaxed),
+            event.start.load(std::memory_order_relaxed),
+            event.end.load(std::memory_order_relaxed),
+        };
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence == i + 1 && event.sequence.load(std::memory_order_relaxed) == sequence) {
+            events->push_back(copied);
+        }
+    }
+}
+
+}  // namespace anonymous
+
+const char* get_trace_op_name(trace_op op) {
+    switch (op) {
+    case TRACE_CALL_METHOD:
+        return "call_method";
+    case TRACE_CALL_STATIC_METHOD:
+        return "call_static_method";
+    case TRACE_NEW_OBJECT:
+        return "new_object";
+    case TRACE_GET_FIELD:
+        return "get_field";
+    case TRACE_SET_FIELD:
+        return "set_field";
+    case TRACE_GET_STATIC_FIELD:
+        return "get_static_field";
+    case TRACE_SET_STATIC_FIELD:
+        return "set_static_field";
+    }
+    return "?";
+}
+
+void record_trace_event(const call_site* site, uint64_t start, uint64_t end) {
+    trace_buffer* buffer = get_thread_buffer();
+    uint64_t index = buffer->head.load(std::memory_order_relaxed);
+    trace_event& event = buffer->events[index % buffer->capacity];
+
+    event.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.site.store(site, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    event.sequence.store(index + 1, std::memory_order_release);
+
+    buffer->head.store(index + 1, std::memory_order_release);
+}
+
+void start_tracing(size_t events_per_thread) {
+    // Threads that have already recorded events keep their buffers.
+    g_events_per_thread.store(std::max<size_t>(events_per_thread, 1));
+    g_tracing.store(true);
+}
+
+void stop_tracing() {
+    g_tracing.store(false);
+}
+
+void clear_trace() {
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    g_buffers.erase(std::remove_if(g_buffers.begin(), g_buffers.end(), [](const std::unique_ptr<trace_buffer>& buffer) {
+        return buffer->exited.load();
+    }), g_buffers.end());
+
+    for (auto& buffer : g_buffers) {
+        buffer->first.store(buffer->head.load());
+    }
+}
+
+void write_chrome_trace(std::ostream& out) {
+    uint64_t pid = get_process_id();
+    std::vector<copied_event> events;
+    bool first_event = true;
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    for (auto& buffer : g_buffers) {
+        events.clear();
+        copy_events(*buffer, &events);
+
+        for (const copied_event& event : events) {
+            out << (first_event ? "\n" : ",\n");
+            first_event = false;
+
+            std::string name = std::string(event.site->class_name) + "." + event.site->name;
+            out << "{\"name\":";
+            write_json_string(out, name.c_str());
+            out << ",\"cat\":\"" << get_trace_op_name(event.site->op) << "\",\"ph\":\"X\",\"ts\":";
+            write_micros(out, event.start);
+            out << ",\"dur\":";
+            write_micros(out, event.end - event.start);
+            out << ",\"pid\":" << pid << ",\"tid\":" << buffer->thread_id << ",\"args\":{\"descriptor\":";
+            write_json_string(out, event.site->descriptor);
+            out << "}}";
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+}  // namespace whatjni
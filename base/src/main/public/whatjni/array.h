@@ -5,10 +5,21 @@
 #include "whatjni/type_traits.h"
 #include "java/lang/Object.class.h"
 
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#if WHATJNI_LANG >= 202002L
+    #include <span>
+#endif
+
 namespace whatjni {
 
 template <typename T> class array;
 
+// Number of elements copied per Get/Set<T>ArrayRegion call when the source is not contiguous in memory.
+const jsize ARRAY_CHUNK_LENGTH = 1024;
+
 template <typename T, typename AT, typename MAP, int MODE>
 class mapped_array {
     array<T>* array_;
@@ -94,6 +105,31 @@ public:
     }
     WHATJNI_IF_PROPERTY(__declspec(property(get=get_data, put=set_data)) T data[];)
 
+    // Bulk copies between primitive arrays and native memory, each a single JNI call.
+    void read_region(jsize start, jsize length, T* buffer) {
+        static_assert(std::is_arithmetic<T>::value, "Only primitive arrays have regions");
+        get_array_region((jarray) this, start, length, buffer);
+    }
+    void write_region(jsize start, jsize length, const T* buffer) {
+        static_assert(std::is_arithmetic<T>::value, "Only primitive arrays have regions");
+        set_array_region((jarray) this, start, length, buffer);
+    }
+
+#if WHATJNI_LANG >= 202002L
+    void read_region(jsize start, std::span<T> buffer) {
+        read_region(start, jsize(buffer.size()), buffer.data());
+    }
+    void write_region(jsize start, std::span<const T> buffer) {
+        write_region(start, jsize(buffer.size()), buffer.data());
+    }
+#endif
+
+    std::vector<T> to_vector() {
+        std::vector<T> result(get_length());
+        read_region(0, jsize(result.size()), result.data());
+        return result;
+    }
+
     mapped_array<T, T&, MapRegular, 0> map() {
         return mapped_array<T, T&, MapRegular, 0>(this, -1);
     }
@@ -113,6 +149,52 @@ ref<array<R>> new_array(jsize size) {
     return TypeTraits<R>::new_array(size);
 }
 
+// Returns a new primitive array holding a copy of native elements.
+template<typename R>
+ref<array<R>> new_array_from(const R* elements, jsize length) {
+    auto result = new_array<R>(length);
+    result->write_region(0, length, elements);
+    return result;
+}
+
+// Returns a new primitive array holding a copy of the elements in [first, last), copied ARRAY_CHUNK_LENGTH elements per
+// JNI call.
+template <typename Iter>
+auto new_array_from(Iter first, Iter last) {
+    typedef typename std::iterator_traits<Iter>::value_type R;
+    auto result = new_array<R>(jsize(std::distance(first, last)));
+
+    R chunk[ARRAY_CHUNK_LENGTH];
+    jsize start = 0;
+    while (first != last) {
+        jsize length = 0;
+        for (; first != last && length < ARRAY_CHUNK_LENGTH; ++first) {
+            chunk[length++] = *first;
+        }
+        result->write_region(start, length, chunk);
+        start += length;
+    }
+
+    return result;
+}
+
+template <typename Range, typename = void>
+struct is_contiguous_range: std::false_type {};
+
+template <typename Range>
+struct is_contiguous_range<Range, std::void_t<decltype(std::data(std::declval<const Range&>()))>>: std::true_type {};
+
+// Returns a new primitive array holding a copy of a range, e.g. a std::vector. Ranges that are contiguous in memory are
+// copied with a single JNI call.
+template <typename Range>
+auto new_array_from(const Range& range) {
+    if constexpr (is_contiguous_range<Range>::value) {
+        return new_array_from(std::data(range), jsize(std::size(range)));
+    } else {
+        return new_array_from(std::begin(range), std::end(range));
+    }
+}
+
 }  // namespace whatjni
 
 #endif  // WHATJNI_ARRAY_H
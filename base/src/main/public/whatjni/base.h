@@ -4,7 +4,9 @@
 #include "whatjni/jni.h"
 #include "utf8.h"
 
+#include <cstdint>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #ifndef WHATJNI_LANG
@@ -72,8 +74,9 @@ public:
 
 // Thrown when JVM exception detected.
 class WHATJNI_BASE jvm_exception {
-    jobject exception_;
+    jobject exception_;  // global ref
 public:
+    // Takes ownership of a local ref to the Throwable.
     explicit jvm_exception(jobject exception);
     jvm_exception(const jvm_exception& rhs);
     jvm_exception(jvm_exception&& rhs);
@@ -81,9 +84,86 @@ public:
 
     jvm_exception& operator=(const jvm_exception&) = delete;
 
+    // Owned by the jvm_exception.
+    jthrowable get_throwable() const { return (jthrowable) exception_; }
+
     std::string get_message() const;
 };
 
+// While an instance is in scope on the current thread, field and array element accessors do not check for a pending Java
+// exception after each JNI call. Instead, the check happens once when the outermost instance goes out of scope or when
+// check() is called. JNI permits only a few functions, e.g. ExceptionCheck and DeleteLocalRef, to be called while an
+// exception is pending, so batch only accessors that are not expected to throw, e.g. reads of fields of objects known to
+// be non-null or writes to array indices known to be in range. Method calls and other operations still check
+// immediately.
+class WHATJNI_BASE deferred_exception_check {
+    int uncaught_exceptions_;
+public:
+    deferred_exception_check();
+    ~deferred_exception_check() noexcept(false);
+
+    deferred_exception_check(const deferred_exception_check&) = delete;
+    deferred_exception_check& operator=(const deferred_exception_check&) = delete;
+
+    void check();
+};
+
+// While an instance is in scope on the current thread, GlobalRefs deleted by delete_global_ref(), including those held
+// by ref<T> and global_ref<T>, are queued rather than deleted immediately, so a teardown path that destroys many refs
+// does not take the JVM's global handle lock for each one. GlobalRefs deleted on threads that are not attached to the
+// JVM are always queued, so refs may be destroyed on any thread.
+//
+// delete_queued_global_refs() deletes queued GlobalRefs in one batch. It is called by global_ref_reclaimer, on entry
+// to generated native methods and by shutdown_vm(). Each thread queues GlobalRefs in chunks, which only become visible
+// to delete_queued_global_refs() when full, when the outermost instance goes out of scope or when the thread exits.
+class WHATJNI_BASE deferred_global_ref_deletion {
+public:
+    deferred_global_ref_deletion();
+    ~deferred_global_ref_deletion();
+
+    deferred_global_ref_deletion(const deferred_global_ref_deletion&) = delete;
+    deferred_global_ref_deletion& operator=(const deferred_global_ref_deletion&) = delete;
+};
+
+// Returns the number of GlobalRefs deleted.
+WHATJNI_BASE size_t delete_queued_global_refs();
+WHATJNI_BASE size_t get_num_queued_global_ref_deletions();
+
+// Counts of refs created and deleted through whatjni by one thread, or by all threads. Every LocalRef returned by a JNI
+// function, e.g. a method result, counts as created, but LocalRefs released by popping a local frame or returning from
+// a native method do not count as deleted. A queued GlobalRef counts as deleted when delete_queued_global_refs()
+// deletes it, against the thread that calls it.
+struct ref_counts {
+    uint64_t thread_id = 0;  // zero for totals
+    uint64_t local_refs_created = 0;
+    uint64_t local_refs_deleted = 0;
+    uint64_t global_refs_created = 0;
+    uint64_t global_refs_deleted = 0;
+    uint64_t weak_refs_created = 0;
+    uint64_t weak_refs_deleted = 0;
+    uint64_t peak_frame_depth = 0;
+
+    int64_t live_global_refs() const { return int64_t(global_refs_created - global_refs_deleted); }
+    int64_t live_weak_refs() const { return int64_t(weak_refs_created - weak_refs_deleted); }
+};
+
+struct ref_stats_snapshot {
+    ref_counts total;                 // including threads that have exited
+    std::vector<ref_counts> threads;  // threads that have called into the JVM through whatjni and not yet exited
+};
+
+// Each thread counts into its own counters, so counting does not contend. Taking a snapshot briefly locks the list of
+// threads.
+WHATJNI_BASE ref_stats_snapshot ref_stats();
+
+// While enabled, the call stack that created each GlobalRef and WeakGlobalRef is recorded until the ref is deleted.
+// shutdown_vm() prints those still live to stderr. This is slow, so only for tracking down leaks.
+WHATJNI_BASE void set_ref_site_tracking(bool enabled);
+
+// Describes each GlobalRef and WeakGlobalRef created while tracking was enabled that has not been deleted, with the
+// call stack that created it.
+WHATJNI_BASE std::vector<std::string> get_live_ref_sites();
+
 struct vm_config {
     explicit vm_config(jint version): version(version) {}
 
@@ -92,24 +172,77 @@ struct vm_config {
     std::vector<std::string> classpath;
     jboolean ignore_unrecognized = false;
     std::vector<std::string> extra;
+    bool resolve_bindings = false;  // resolve all generated bindings during initialize_vm
+    bool track_ref_sites = false;   // see set_ref_site_tracking
 };
 
 WHATJNI_BASE void initialize_vm(const vm_config& config);
+
+// Deletes the GlobalRefs whatjni holds and destroys the JVM. Nothing may use whatjni afterwards, on any thread,
+// including destructors of refs with static storage duration.
 WHATJNI_BASE void shutdown_vm();
 
 WHATJNI_BASE void initialize_thread(JNIEnv* env);
 
+struct attach_options {
+    bool daemon = false;  // a JVM does not wait for daemon threads to detach before shutting down
+    std::string name;     // Java thread name, or empty for the JVM's default
+    jobject group = nullptr;  // global ref to a ThreadGroup, or null for the main thread group
+};
+
+// A thread that is not attached to the JVM is attached, with these options, the first time it calls into the JVM, and
+// detached when it exits. Non-daemon threads attached this way keep shutdown_vm() waiting until they exit.
+WHATJNI_BASE void set_auto_attach_options(const attach_options& options);
+
+// Attaches the current thread to the JVM with the options passed to set_auto_attach_options(), unless it is already
+// attached, and returns its JNIEnv, e.g. to call JNI functions directly. A thread attached this way is detached when it
+// exits. Once that has happened, e.g. in a later thread_local destructor, this throws jvm_error(JNI_EDETACHED) rather
+// than attaching the thread again.
+WHATJNI_BASE JNIEnv* attach_current_thread();
+
+// Attaches the current thread to the JVM for the lifetime of the scope, unless it is already attached.
+class WHATJNI_BASE scoped_attach {
+    bool attached_;
+public:
+    explicit scoped_attach(const attach_options& options = attach_options());
+    ~scoped_attach();
+
+    scoped_attach(const scoped_attach&) = delete;
+    scoped_attach& operator=(const scoped_attach&) = delete;
+};
+
 WHATJNI_BASE jclass find_class(const char* name);
+
+// Process-wide cache of classes, each promoted to a global ref the first time it is looked up so the result may be used
+// from any thread. Classes are loaded through the application class loader captured by initialize_vm(), or whichever is
+// passed to set_class_loader(), rather than the class loader FindClass would choose for the calling thread. Looking up
+// a class that is already cached does not lock.
+class WHATJNI_BASE class_cache {
+public:
+    static jclass get(const char* name);
+
+    // Called when the native module is loaded by a JVM it did not create, e.g. from JNI_OnLoad. Without a class loader,
+    // classes are loaded with FindClass.
+    static void set_class_loader(jobject loader);
+
+    // Deletes the cached global refs and frees the cache's entries, which get() reads without locking, and resets every
+    // class, method and field binding. Classes returned earlier are also held by function-local statics within
+    // whatjni, so this is only for shutdown_vm(), after which nothing may use whatjni.
+    static void clear();
+};
+
 WHATJNI_BASE jclass get_super_class(jclass clazz);
 WHATJNI_BASE jboolean is_assignable_from(jclass clazz1, jclass clazz2);
 WHATJNI_BASE jboolean is_instance_of(jobject obj, jclass clazz);
+WHATJNI_BASE jclass get_object_class(jobject obj);
+WHATJNI_BASE jobject to_reflected_method(jclass clazz, jmethodID method, jboolean is_static);
 WHATJNI_BASE jfieldID get_field_id(jclass clazz, const char* name, const char* sig);
 WHATJNI_BASE jfieldID get_static_field_id(jclass clazz, const char* name, const char* sig);
 WHATJNI_BASE jmethodID get_method_id(jclass clazz, const char* name, const char* sig);
 WHATJNI_BASE jmethodID get_static_method_id(jclass clazz, const char* name, const char* sig);
 
 WHATJNI_BASE jobject alloc_object(jclass clazz);
-WHATJNI_BASE jobject new_object(jclass clazz, jmethodID method, ...);
+WHATJNI_BASE jobject new_object_a(jclass clazz, jmethodID method, const jvalue* args);
 
 WHATJNI_BASE jboolean is_same_object(jobject l, jobject r);
 WHATJNI_BASE jboolean is_equal_object(jobject l, jobject r);
@@ -164,43 +297,117 @@ WHATJNI_EACH_JAVA_TYPE()
 
 
 template <typename T>
-T call_method(jobject obj, jmethodID method, ...);
+T call_method_a(jobject obj, jmethodID method, const jvalue* args);
 
 template <>
-void WHATJNI_BASE call_method(jobject obj, jmethodID method, ...);
+WHATJNI_BASE void call_method_a(jobject obj, jmethodID method, const jvalue* args);
 
-#define X(T) template<> WHATJNI_BASE T call_method(jobject obj, jmethodID method, ...);
+#define X(T) template<> WHATJNI_BASE T call_method_a(jobject obj, jmethodID method, const jvalue* args);
 WHATJNI_EACH_JAVA_TYPE()
 #undef X
 
 
 template <typename T>
-T call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...);
+T call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args);
 
 template <>
-WHATJNI_BASE void call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...);
+WHATJNI_BASE void call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args);
 
-#define X(T) template<> WHATJNI_BASE T call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, ...);
+#define X(T) template<> WHATJNI_BASE T call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, \
+                                                                const jvalue* args);
 WHATJNI_EACH_JAVA_TYPE()
 #undef X
 
 
 template <typename T>
-T call_static_method(jclass clazz, jmethodID method, ...);
+T call_static_method_a(jclass clazz, jmethodID method, const jvalue* args);
 
 template <>
-WHATJNI_BASE void call_static_method(jclass clazz, jmethodID method, ...);
+WHATJNI_BASE void call_static_method_a(jclass clazz, jmethodID method, const jvalue* args);
 
-#define X(T) template<> WHATJNI_BASE T call_static_method(jclass clazz, jmethodID method, ...);
+#define X(T) template<> WHATJNI_BASE T call_static_method_a(jclass clazz, jmethodID method, const jvalue* args);
 WHATJNI_EACH_JAVA_TYPE()
 #undef X
 
+
+// Converts an argument of a Java method call to the jvalue the Call*MethodA functions expect. Each argument must be
+// exactly the JNI type of its parameter, or bool for boolean, since the jmethodID does not say which union member the
+// JVM will read: a double passed for a float parameter would set the wrong one. Cast other arithmetic types, e.g.
+// integer literals, to the JNI type.
+template <typename T>
+jvalue to_jvalue(T value) {
+    jvalue result{};
+    if constexpr (std::is_same_v<T, jboolean> || std::is_same_v<T, bool>) {
+        result.z = value;
+    } else if constexpr (std::is_same_v<T, jbyte>) {
+        result.b = value;
+    } else if constexpr (std::is_same_v<T, jchar>) {
+        result.c = value;
+    } else if constexpr (std::is_same_v<T, jshort>) {
+        result.s = value;
+    } else if constexpr (std::is_same_v<T, jint>) {
+        result.i = value;
+    } else if constexpr (std::is_same_v<T, jlong>) {
+        result.j = value;
+    } else if constexpr (std::is_same_v<T, jfloat>) {
+        result.f = value;
+    } else if constexpr (std::is_same_v<T, jdouble>) {
+        result.d = value;
+    } else {
+        static_assert(std::is_convertible_v<T, jobject>, "Argument of a Java method must have a JNI type");
+        result.l = value;
+    }
+    return result;
+}
+
+// The arguments are marshalled into an array on the stack at compile time rather than through C varargs. The extra
+// element avoids a zero length array when there are no arguments.
+template <typename T, typename... Args>
+T call_method(jobject obj, jmethodID method, Args... args) {
+    jvalue values[sizeof...(Args) + 1] = { to_jvalue(args)... };
+    return call_method_a<T>(obj, method, values);
+}
+
+template <typename T, typename... Args>
+T call_nonvirtual_method(jobject obj, jclass clazz, jmethodID method, Args... args) {
+    jvalue values[sizeof...(Args) + 1] = { to_jvalue(args)... };
+    return call_nonvirtual_method_a<T>(obj, clazz, method, values);
+}
+
+template <typename T, typename... Args>
+T call_static_method(jclass clazz, jmethodID method, Args... args) {
+    jvalue values[sizeof...(Args) + 1] = { to_jvalue(args)... };
+    return call_static_method_a<T>(clazz, method, values);
+}
+
+template <typename... Args>
+jobject new_object(jclass clazz, jmethodID method, Args... args) {
+    jvalue values[sizeof...(Args) + 1] = { to_jvalue(args)... };
+    return new_object_a(clazz, method, values);
+}
+
 WHATJNI_BASE jstring new_string(const jchar* str, jsize length);
 WHATJNI_BASE jstring new_utf8_string(const char* str, jsize length);
 WHATJNI_BASE jstring new_utf8_string(const char* str);
+
+// Returns a new GlobalRef to a Java string. If intern is true, the string is the canonical one returned by
+// String.intern(), so equal strings created this way, and equal string literals in Java code, are the same object.
+WHATJNI_BASE jstring new_global_utf8_string(const char* str, jsize length, bool intern);
 WHATJNI_BASE jsize get_string_length(jstring str);
 WHATJNI_BASE const jchar* get_string_chars(jstring str, jboolean* is_copy);
 WHATJNI_BASE void release_string_chars(jstring str, const jchar* chars);
+WHATJNI_BASE jsize get_string_utf_length(jstring str);
+WHATJNI_BASE void get_string_region(jstring str, jsize start, jsize length, jchar* buffer);
+WHATJNI_BASE void get_string_utf_region(jstring str, jsize start, jsize length, char* buffer);
+
+// Conversions of Java strings to UTF-8 and UTF-16. The result is sized up front and filled by a single JNI call.
+WHATJNI_BASE std::string to_std_string(jstring str);
+WHATJNI_BASE std::u16string to_u16string(jstring str);
+
+// Writes a null terminated UTF-8 string to a caller provided buffer and returns its length, excluding the terminator.
+// If capacity might be too small, nothing is written and the capacity needed, which is greater than capacity, is
+// returned instead. So, like snprintf, the conversion succeeded if the result is less than capacity.
+WHATJNI_BASE size_t to_utf8(jstring str, char* buffer, size_t capacity);
 
 template <typename T> jarray new_primitive_array(jsize size);
 
@@ -224,6 +431,19 @@ template <typename T> void set_array_element(jarray array, jsize idx, T value);
 WHATJNI_EACH_JAVA_TYPE()
 #undef X
 
+// Copies length elements starting at start with one JNI call.
+template <typename T> void get_array_region(jarray array, jsize start, jsize length, T* buffer);
+
+#define X(T) template<> WHATJNI_BASE void get_array_region(jarray array, jsize start, jsize length, T* buffer);
+WHATJNI_EACH_PRIMITIVE_TYPE()
+#undef X
+
+template <typename T> void set_array_region(jarray array, jsize start, jsize length, const T* buffer);
+
+#define X(T) template<> WHATJNI_BASE void set_array_region(jarray array, jsize start, jsize length, const T* buffer);
+WHATJNI_EACH_PRIMITIVE_TYPE()
+#undef X
+
 template <typename T> T* get_array_elements(jarray array, jboolean* isCopy);
 
 #define X(T) template<> WHATJNI_BASE T* get_array_elements(jarray array, jboolean* isCopy);
@@ -242,6 +462,103 @@ WHATJNI_BASE void release_primitive_array_critical(jarray array, void* elements,
 WHATJNI_BASE void push_local_frame(jint size);
 WHATJNI_BASE jobject pop_local_frame(jobject result = nullptr);
 
+// Pops the current local frame, leaving any pending exception for an enclosing check, e.g. that of a
+// deferred_exception_check. For destructors, which must not throw.
+WHATJNI_BASE void pop_local_frame_unchecked() noexcept;
+
+// Ensures at least capacity more LocalRefs can be created in the current frame, ahead of work known to create them.
+WHATJNI_BASE void ensure_local_capacity(jint capacity);
+
+// Pushes a local frame with room for capacity LocalRefs and pops it at the end of the scope, deleting every LocalRef
+// created in it, including those held by local_ref<T> and ref<T> on the stack, which must not outlive the frame. One
+// LocalRef can escape into the enclosing frame through pop(result).
+class scoped_local_frame {
+    bool popped_ = false;
+public:
+    explicit scoped_local_frame(jint capacity = 16) {
+        push_local_frame(capacity);
+    }
+
+    ~scoped_local_frame() {
+        if (!popped_) {
+            pop_local_frame_unchecked();
+        }
+    }
+
+    scoped_local_frame(const scoped_local_frame&) = delete;
+    scoped_local_frame& operator=(const scoped_local_frame&) = delete;
+
+    // Pops the frame early, returning a LocalRef to result in the enclosing frame.
+    jobject pop(jobject result) {
+        popped_ = true;
+        return pop_local_frame(result);
+    }
+};
+
+// Bounds the LocalRefs a long loop accumulates by replacing the current local frame with a new one every interval
+// iterations, so the JVM's local ref table, which the garbage collector scans as roots, stays small. Each frame has room
+// for interval * refs_per_iteration LocalRefs.
+//
+//     rolling_local_frame frames(100);
+//     for (...) {
+//         ... create LocalRefs ...
+//         frames.next();
+//     }
+//
+// LocalRefs created in an iteration are valid until next() is called, so ref<T> and local_ref<T> holding them must be
+// declared inside the loop body. A ref that must live across iterations, e.g. an accumulated result, can be carried
+// into the new frame by next(carry), which returns the LocalRef to use from then on, and out of the loop by pop(result).
+class rolling_local_frame {
+    jint interval_;
+    jint capacity_;
+    jint count_ = 0;
+    bool popped_ = false;
+public:
+    explicit rolling_local_frame(jint interval, jint refs_per_iteration = 1)
+        : interval_(interval), capacity_(interval * refs_per_iteration) {
+        push_local_frame(capacity_);
+    }
+
+    ~rolling_local_frame() {
+        if (!popped_) {
+            pop_local_frame_unchecked();
+        }
+    }
+
+    rolling_local_frame(const rolling_local_frame&) = delete;
+    rolling_local_frame& operator=(const rolling_local_frame&) = delete;
+
+    void next() {
+        if (++count_ == interval_) {
+            count_ = 0;
+            pop_local_frame();
+            push_local_frame(capacity_);
+        }
+    }
+
+    jobject next(jobject carry) {
+        if (++count_ != interval_) {
+            return carry;
+        }
+
+        count_ = 0;
+        jobject outer = pop_local_frame(carry);
+        push_local_frame(capacity_);
+        jobject inner = new_local_ref(outer);
+        delete_local_ref(outer);
+        return inner;
+    }
+
+    jobject pop(jobject result) {
+        popped_ = true;
+        return pop_local_frame(result);
+    }
+};
+
+WHATJNI_BASE jobject new_direct_byte_buffer(void* address, jlong capacity);
+WHATJNI_BASE void* get_direct_buffer_address(jobject buffer);
+WHATJNI_BASE jlong get_direct_buffer_capacity(jobject buffer);
+
 WHATJNI_BASE void register_natives(jclass clazz, const JNINativeMethod* methods, jint numMethods);
 
 }  // namespace whatjni
@@ -249,4 +566,8 @@ WHATJNI_BASE void register_natives(jclass clazz, const JNINativeMethod* methods,
 #undef WHATJNI_EACH_PRIMITIVE_TYPE
 #undef WHATJNI_EACH_JAVA_TYPE
 
+#ifdef WHATJNI_INLINE
+    #include "whatjni/base_inline.h"
+#endif
+
 #endif  // WHATJNI_BASE_H
@@ -0,0 +1,920 @@
+#ifndef WHATJNI_BASE_INLINE_H
+#define WHATJNI_BASE_INLINE_H
+
+// Wrappers for the JNI functions called most often, e.g. field and array element accessors, method calls and ref
+// management. By default they are compiled once into base.cpp and exported like the rest of the library. When
+// WHATJNI_INLINE is defined, for the library and every module that uses it, they are instead inline functions in every
+// translation unit that includes base.h, which removes the call into the base library ahead of each call through the
+// JNIEnv function table and lets the compiler see through them.
+//
+// In that mode the per-thread JNIEnv is an exported thread local variable using the initial-exec TLS model, so reading
+// it is a single load relative to the thread pointer rather than a call to __tls_get_addr. The base library must then
+// be loaded at program startup or early enough that static TLS space is still available, which is the case when it is
+// linked as a STATIC library or as a SHARED library the executable depends on directly.
+
+#include "whatjni/base.h"
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef WHATJNI_INLINE
+    #ifdef _WIN32
+        // Thread local variables cannot be imported from a DLL.
+        #error "WHATJNI_INLINE is not supported on Windows"
+    #endif
+
+    #define WHATJNI_BASE_INLINE inline
+
+    #if defined(__ELF__)
+        #define WHATJNI_THREAD_LOCAL __thread __attribute__((tls_model("initial-exec")))
+    #else
+        #define WHATJNI_THREAD_LOCAL __thread
+    #endif
+#else
+    #define WHATJNI_BASE_INLINE
+    #define WHATJNI_THREAD_LOCAL static thread_local
+#endif
+
+namespace whatjni {
+
+class batch;
+
+// Defined in batch.cpp. A batch replays consecutive calls on the same receiver without storing it again, but deleting
+// a ref lets its handle be reused for another object, so deleting obj, or popping a local frame, which passes null,
+// makes the batch store the next receiver.
+WHATJNI_BASE void forget_batched_receiver(batch* b, jobject obj) noexcept;
+
+enum ref_counter {
+    LOCAL_REFS_CREATED,
+    LOCAL_REFS_DELETED,
+    GLOBAL_REFS_CREATED,
+    GLOBAL_REFS_DELETED,
+    WEAK_REFS_CREATED,
+    WEAK_REFS_DELETED,
+    NUM_REF_COUNTERS,
+};
+
+// Written only by the thread they belong to, so incrementing a counter needs no atomic read-modify-write, and read by
+// ref_stats() on any thread.
+struct thread_ref_counters {
+    uint64_t thread_id;
+    std::atomic<uint64_t> counts[NUM_REF_COUNTERS];
+    std::atomic<uint64_t> frame_depth;
+    std::atomic<uint64_t> peak_frame_depth;
+};
+
+#ifdef WHATJNI_INLINE
+extern WHATJNI_THREAD_LOCAL JNIEnv* g_env;
+extern WHATJNI_THREAD_LOCAL const char* g_stack_low;
+extern WHATJNI_THREAD_LOCAL size_t g_stack_size;
+extern WHATJNI_THREAD_LOCAL int g_deferred_check_depth;
+extern WHATJNI_THREAD_LOCAL batch* g_batch;
+extern WHATJNI_THREAD_LOCAL int g_deferred_deletion_depth;
+extern WHATJNI_THREAD_LOCAL thread_ref_counters* g_ref_counters;
+extern std::atomic<bool> g_track_ref_sites;
+extern std::atomic<uint64_t> g_global_ref_deletions;
+#else
+// Only base.cpp includes this header when WHATJNI_INLINE is not defined.
+WHATJNI_THREAD_LOCAL JNIEnv* g_env;
+WHATJNI_THREAD_LOCAL const char* g_stack_low;
+WHATJNI_THREAD_LOCAL size_t g_stack_size;
+WHATJNI_THREAD_LOCAL int g_deferred_check_depth;
+WHATJNI_THREAD_LOCAL batch* g_batch;
+WHATJNI_THREAD_LOCAL int g_deferred_deletion_depth;
+WHATJNI_THREAD_LOCAL thread_ref_counters* g_ref_counters;
+static std::atomic<bool> g_track_ref_sites;
+static std::atomic<uint64_t> g_global_ref_deletions;
+#endif
+
+inline JNIEnv* get_env() {
+    JNIEnv* env = g_env;
+    return env ? env : attach_current_thread();
+}
+
+inline void count_ref(ref_counter counter) {
+    if (thread_ref_counters* counters = g_ref_counters) {
+        auto& count = counters->counts[counter];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+// Record or forget where a GlobalRef or WeakGlobalRef was created when set_ref_site_tracking() is enabled.
+WHATJNI_BASE void track_ref_site(jobject obj, jobjectRefType type);
+WHATJNI_BASE void untrack_ref_site(jobject obj);
+
+// Clears the pending Java exception and throws it as a jvm_exception.
+[[noreturn]] WHATJNI_BASE void throw_pending_exception();
+
+// ExceptionCheck is cheaper than ExceptionOccurred, which creates a local ref to the exception even when none is pending,
+// so the exception is only fetched once it is known to be there.
+inline void check_exception() {
+    if (get_env()->ExceptionCheck()) {
+        throw_pending_exception();
+    }
+}
+
+// Every JNI function whose result goes through here and is an object returns a new LocalRef.
+template <typename T>
+inline T check_exception(T result) {
+    check_exception();
+    if constexpr (std::is_convertible<T, jobject>::value) {
+        if (result) {
+            count_ref(LOCAL_REFS_CREATED);
+        }
+    }
+    return result;
+}
+
+// Used by accessors that may be batched under a deferred_exception_check.
+inline void check_deferrable_exception() {
+    if (!g_deferred_check_depth) {
+        check_exception();
+    }
+}
+
+template <typename T>
+inline T check_deferrable_exception(T result) {
+    check_deferrable_exception();
+    return result;
+}
+
+WHATJNI_BASE_INLINE jboolean is_same_object(jobject l, jobject r) {
+    auto result = get_env()->IsSameObject(l, r);
+    check_exception();
+    return result;
+}
+
+WHATJNI_BASE_INLINE jobject new_local_ref(jobject obj) {
+    return check_exception(get_env()->NewLocalRef(obj));
+}
+
+WHATJNI_BASE_INLINE void delete_local_ref(jobject obj) {
+    if (batch* b = g_batch) {
+        forget_batched_receiver(b, obj);
+    }
+    get_env()->DeleteLocalRef(obj);
+    check_exception();
+    if (obj) {
+        count_ref(LOCAL_REFS_DELETED);
+    }
+}
+
+WHATJNI_BASE_INLINE jobject new_global_ref(jobject obj) {
+    jobject result = get_env()->NewGlobalRef(obj);
+    check_exception();
+    if (result) {
+        count_ref(GLOBAL_REFS_CREATED);
+        if (g_track_ref_sites.load(std::memory_order_relaxed)) {
+            track_ref_site(result, JNIGlobalRefType);
+        }
+    }
+    return result;
+}
+
+// Queues a GlobalRef to be deleted by delete_queued_global_refs(). Does not call into the JVM.
+WHATJNI_BASE void queue_global_ref_deletion(jobject obj);
+
+WHATJNI_BASE_INLINE void delete_global_ref(jobject obj) {
+    // A thread that is not attached is not attached just to delete a GlobalRef.
+    if (!g_env || g_deferred_deletion_depth) {
+        queue_global_ref_deletion(obj);
+        return;
+    }
+    if (obj) {
+        count_ref(GLOBAL_REFS_DELETED);
+        if (g_track_ref_sites.load(std::memory_order_relaxed)) {
+            untrack_ref_site(obj);
+        }
+        // Another thread's batch might have recorded a call on obj.
+        g_global_ref_deletions.fetch_add(1, std::memory_order_relaxed);
+    }
+    g_env->DeleteGlobalRef(obj);
+    check_exception();
+}
+
+WHATJNI_BASE_INLINE jobject new_weak_global_ref(jobject obj) {
+    jobject result = get_env()->NewWeakGlobalRef(obj);
+    check_exception();
+    if (result) {
+        count_ref(WEAK_REFS_CREATED);
+        if (g_track_ref_sites.load(std::memory_order_relaxed)) {
+            track_ref_site(result, JNIWeakGlobalRefType);
+        }
+    }
+    return result;
+}
+
+WHATJNI_BASE_INLINE void delete_weak_global_ref(jobject obj) {
+    if (obj) {
+        count_ref(WEAK_REFS_DELETED);
+        if (g_track_ref_sites.load(std::memory_order_relaxed)) {
+            untrack_ref_site(obj);
+        }
+        g_global_ref_deletions.fetch_add(1, std::memory_order_relaxed);
+    }
+    get_env()->DeleteWeakGlobalRef(obj);
+    check_exception();
+}
+
+WHATJNI_BASE_INLINE jobjectRefType get_object_ref_type(jobject obj) {
+    return check_exception(get_env()->GetObjectRefType(obj));
+}
+
+inline bool is_auto_ref_local(jobject* refref) {
+    const char* address = (const char*) refref;
+    return address - g_stack_low < g_stack_size;
+}
+
+WHATJNI_BASE_INLINE void new_auto_ref(jobject* refref, jobject obj) {
+    if (is_auto_ref_local(refref)) {
+        *refref = new_local_ref(obj);
+    } else {
+        *refref = new_global_ref(obj);
+    }
+}
+
+WHATJNI_BASE_INLINE void move_auto_ref(jobject* to, jobject* from) {
+    bool toLocal = is_auto_ref_local(to);
+    bool fromLocal = is_auto_ref_local(from);
+
+    if (toLocal == fromLocal) {
+        *to = *from;
+    } else if (toLocal) {
+        *to = new_local_ref(*from);
+        delete_global_ref(*from);
+    } else {
+        *to = new_global_ref(*from);
+        delete_local_ref(*from);
+    }
+
+    *from = nullptr;
+}
+
+WHATJNI_BASE_INLINE void delete_auto_ref(jobject* refref) {
+    if (is_auto_ref_local(refref)) {
+        delete_local_ref(*refref);
+    } else {
+        delete_global_ref(*refref);
+    }
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_field(jobject obj, jfieldID field, jboolean value) {
+    get_env()->SetBooleanField(obj, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jboolean get_field(jobject obj, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetBooleanField(obj, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_field(jobject obj, jfieldID field, jbyte value) {
+    get_env()->SetByteField(obj, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jbyte get_field(jobject obj, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetByteField(obj, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_field(jobject obj, jfieldID field, jshort value) {
+    get_env()->SetShortField(obj, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jshort get_field(jobject obj, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetShortField(obj, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_field(jobject obj, jfieldID field, jint value) {
+    get_env()->SetIntField(obj, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jint get_field(jobject obj, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetIntField(obj, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_field(jobject obj, jfieldID field, jlong value) {
+    get_env()->SetLongField(obj, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jlong get_field(jobject obj, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetLongField(obj, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_field(jobject obj, jfieldID field, jchar value) {
+    get_env()->SetCharField(obj, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jchar get_field(jobject obj, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetCharField(obj, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_field(jobject obj, jfieldID field, jfloat value) {
+    get_env()->SetFloatField(obj, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jfloat get_field(jobject obj, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetFloatField(obj, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_field(jobject obj, jfieldID field, jdouble value) {
+    get_env()->SetDoubleField(obj, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jdouble get_field(jobject obj, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetDoubleField(obj, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_field(jobject obj, jfieldID field, jobject value) {
+    get_env()->SetObjectField(obj, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jobject get_field(jobject obj, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetObjectField(obj, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_static_field(jclass clazz, jfieldID field, jboolean value) {
+    get_env()->SetStaticBooleanField(clazz, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jboolean get_static_field(jclass clazz, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetStaticBooleanField(clazz, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_static_field(jclass clazz, jfieldID field, jbyte value) {
+    get_env()->SetStaticByteField(clazz, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jbyte get_static_field(jclass clazz, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetStaticByteField(clazz, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_static_field(jclass clazz, jfieldID field, jshort value) {
+    get_env()->SetStaticShortField(clazz, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jshort get_static_field(jclass clazz, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetStaticShortField(clazz, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_static_field(jclass clazz, jfieldID field, jint value) {
+    get_env()->SetStaticIntField(clazz, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jint get_static_field(jclass clazz, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetStaticIntField(clazz, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_static_field(jclass clazz, jfieldID field, jlong value) {
+    get_env()->SetStaticLongField(clazz, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jlong get_static_field(jclass clazz, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetStaticLongField(clazz, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_static_field(jclass clazz, jfieldID field, jchar value) {
+    get_env()->SetStaticCharField(clazz, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jchar get_static_field(jclass clazz, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetStaticCharField(clazz, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_static_field(jclass clazz, jfieldID field, jfloat value) {
+    get_env()->SetStaticFloatField(clazz, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jfloat get_static_field(jclass clazz, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetStaticFloatField(clazz, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_static_field(jclass clazz, jfieldID field, jdouble value) {
+    get_env()->SetStaticDoubleField(clazz, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jdouble get_static_field(jclass clazz, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetStaticDoubleField(clazz, field));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_static_field(jclass clazz, jfieldID field, jobject value) {
+    get_env()->SetStaticObjectField(clazz, field, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jobject get_static_field(jclass clazz, jfieldID field) {
+    return check_deferrable_exception(get_env()->GetStaticObjectField(clazz, field));
+}
+
+// Defined in batch.cpp.
+WHATJNI_BASE void record_batched_call(batch* b, jclass clazz, jobject obj, jmethodID method, const jvalue* args);
+WHATJNI_BASE void flush_batch(batch* b);
+
+// Calls that return a value might depend on the effects of recorded calls.
+inline void flush_current_batch() {
+    if (batch* b = g_batch) {
+        flush_batch(b);
+    }
+}
+
+template <>
+WHATJNI_BASE_INLINE void call_method_a(jobject obj, jmethodID method, const jvalue* args) {
+    if (batch* b = g_batch) {
+        record_batched_call(b, nullptr, obj, method, args);
+        return;
+    }
+    get_env()->CallVoidMethodA(obj, method, args);
+    check_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jboolean call_method_a(jobject obj, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallBooleanMethodA(obj, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jbyte call_method_a(jobject obj, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallByteMethodA(obj, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jshort call_method_a(jobject obj, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallShortMethodA(obj, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jint call_method_a(jobject obj, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallIntMethodA(obj, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jlong call_method_a(jobject obj, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallLongMethodA(obj, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jchar call_method_a(jobject obj, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallCharMethodA(obj, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jfloat call_method_a(jobject obj, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallFloatMethodA(obj, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jdouble call_method_a(jobject obj, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallDoubleMethodA(obj, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jobject call_method_a(jobject obj, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallObjectMethodA(obj, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE void call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    get_env()->CallNonvirtualVoidMethodA(obj, clazz, method, args);
+    check_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jboolean call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallNonvirtualBooleanMethodA(obj, clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jbyte call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallNonvirtualByteMethodA(obj, clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jshort call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallNonvirtualShortMethodA(obj, clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jint call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallNonvirtualIntMethodA(obj, clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jlong call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallNonvirtualLongMethodA(obj, clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jchar call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallNonvirtualCharMethodA(obj, clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jfloat call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallNonvirtualFloatMethodA(obj, clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jdouble call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallNonvirtualDoubleMethodA(obj, clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jobject call_nonvirtual_method_a(jobject obj, jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallNonvirtualObjectMethodA(obj, clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE void call_static_method_a(jclass clazz, jmethodID method, const jvalue* args) {
+    if (batch* b = g_batch) {
+        record_batched_call(b, clazz, nullptr, method, args);
+        return;
+    }
+    get_env()->CallStaticVoidMethodA(clazz, method, args);
+    check_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jboolean call_static_method_a(jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallStaticBooleanMethodA(clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jbyte call_static_method_a(jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallStaticByteMethodA(clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jshort call_static_method_a(jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallStaticShortMethodA(clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jint call_static_method_a(jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallStaticIntMethodA(clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jlong call_static_method_a(jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallStaticLongMethodA(clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jchar call_static_method_a(jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallStaticCharMethodA(clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jfloat call_static_method_a(jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallStaticFloatMethodA(clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jdouble call_static_method_a(jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallStaticDoubleMethodA(clazz, method, args));
+}
+
+template <>
+WHATJNI_BASE_INLINE jobject call_static_method_a(jclass clazz, jmethodID method, const jvalue* args) {
+    flush_current_batch();
+    return check_exception(get_env()->CallStaticObjectMethodA(clazz, method, args));
+}
+
+WHATJNI_BASE_INLINE jsize get_array_length(jarray array) {
+    return check_exception(get_env()->GetArrayLength(array));
+}
+
+template <>
+WHATJNI_BASE_INLINE jboolean get_array_element(jarray array, jsize idx) {
+    jboolean value;
+    get_env()->GetBooleanArrayRegion((jbooleanArray) array, idx, 1, &value);
+    check_deferrable_exception();
+    return value;
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_element(jarray array, jsize idx, jboolean value) {
+    get_env()->SetBooleanArrayRegion((jbooleanArray) array, idx, 1, &value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jbyte get_array_element(jarray array, jsize idx) {
+    jbyte value;
+    get_env()->GetByteArrayRegion((jbyteArray) array, idx, 1, &value);
+    check_deferrable_exception();
+    return value;
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_element(jarray array, jsize idx, jbyte value) {
+    get_env()->SetByteArrayRegion((jbyteArray) array, idx, 1, &value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jshort get_array_element(jarray array, jsize idx) {
+    jshort value;
+    get_env()->GetShortArrayRegion((jshortArray) array, idx, 1, &value);
+    check_deferrable_exception();
+    return value;
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_element(jarray array, jsize idx, jshort value) {
+    get_env()->SetShortArrayRegion((jshortArray) array, idx, 1, &value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jint get_array_element(jarray array, jsize idx) {
+    jint value;
+    get_env()->GetIntArrayRegion((jintArray) array, idx, 1, &value);
+    check_deferrable_exception();
+    return value;
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_element(jarray array, jsize idx, jint value) {
+    get_env()->SetIntArrayRegion((jintArray) array, idx, 1, &value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jlong get_array_element(jarray array, jsize idx) {
+    jlong value;
+    get_env()->GetLongArrayRegion((jlongArray) array, idx, 1, &value);
+    check_deferrable_exception();
+    return value;
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_element(jarray array, jsize idx, jlong value) {
+    get_env()->SetLongArrayRegion((jlongArray) array, idx, 1, &value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jchar get_array_element(jarray array, jsize idx) {
+    jchar value;
+    get_env()->GetCharArrayRegion((jcharArray) array, idx, 1, &value);
+    check_deferrable_exception();
+    return value;
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_element(jarray array, jsize idx, jchar value) {
+    get_env()->SetCharArrayRegion((jcharArray) array, idx, 1, &value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jfloat get_array_element(jarray array, jsize idx) {
+    jfloat value;
+    get_env()->GetFloatArrayRegion((jfloatArray) array, idx, 1, &value);
+    check_deferrable_exception();
+    return value;
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_element(jarray array, jsize idx, jfloat value) {
+    get_env()->SetFloatArrayRegion((jfloatArray) array, idx, 1, &value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jdouble get_array_element(jarray array, jsize idx) {
+    jdouble value;
+    get_env()->GetDoubleArrayRegion((jdoubleArray) array, idx, 1, &value);
+    check_deferrable_exception();
+    return value;
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_element(jarray array, jsize idx, jdouble value) {
+    get_env()->SetDoubleArrayRegion((jdoubleArray) array, idx, 1, &value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE jobject get_array_element(jarray array, jsize idx) {
+    return check_deferrable_exception(get_env()->GetObjectArrayElement((jobjectArray) array, idx));
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_element(jarray array, jsize idx, jobject value) {
+    get_env()->SetObjectArrayElement((jobjectArray) array, idx, value);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void get_array_region(jarray array, jsize start, jsize length, jboolean* buffer) {
+    get_env()->GetBooleanArrayRegion((jbooleanArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_region(jarray array, jsize start, jsize length, const jboolean* buffer) {
+    get_env()->SetBooleanArrayRegion((jbooleanArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void get_array_region(jarray array, jsize start, jsize length, jbyte* buffer) {
+    get_env()->GetByteArrayRegion((jbyteArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_region(jarray array, jsize start, jsize length, const jbyte* buffer) {
+    get_env()->SetByteArrayRegion((jbyteArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void get_array_region(jarray array, jsize start, jsize length, jshort* buffer) {
+    get_env()->GetShortArrayRegion((jshortArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_region(jarray array, jsize start, jsize length, const jshort* buffer) {
+    get_env()->SetShortArrayRegion((jshortArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void get_array_region(jarray array, jsize start, jsize length, jint* buffer) {
+    get_env()->GetIntArrayRegion((jintArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_region(jarray array, jsize start, jsize length, const jint* buffer) {
+    get_env()->SetIntArrayRegion((jintArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void get_array_region(jarray array, jsize start, jsize length, jlong* buffer) {
+    get_env()->GetLongArrayRegion((jlongArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_region(jarray array, jsize start, jsize length, const jlong* buffer) {
+    get_env()->SetLongArrayRegion((jlongArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void get_array_region(jarray array, jsize start, jsize length, jchar* buffer) {
+    get_env()->GetCharArrayRegion((jcharArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_region(jarray array, jsize start, jsize length, const jchar* buffer) {
+    get_env()->SetCharArrayRegion((jcharArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void get_array_region(jarray array, jsize start, jsize length, jfloat* buffer) {
+    get_env()->GetFloatArrayRegion((jfloatArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_region(jarray array, jsize start, jsize length, const jfloat* buffer) {
+    get_env()->SetFloatArrayRegion((jfloatArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void get_array_region(jarray array, jsize start, jsize length, jdouble* buffer) {
+    get_env()->GetDoubleArrayRegion((jdoubleArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+template <>
+WHATJNI_BASE_INLINE void set_array_region(jarray array, jsize start, jsize length, const jdouble* buffer) {
+    get_env()->SetDoubleArrayRegion((jdoubleArray) array, start, length, buffer);
+    check_deferrable_exception();
+}
+
+WHATJNI_BASE_INLINE void push_local_frame(jint capacity) {
+    get_env()->PushLocalFrame(capacity);
+    check_exception();
+    if (thread_ref_counters* counters = g_ref_counters) {
+        uint64_t depth = counters->frame_depth.load(std::memory_order_relaxed) + 1;
+        counters->frame_depth.store(depth, std::memory_order_relaxed);
+        if (depth > counters->peak_frame_depth.load(std::memory_order_relaxed)) {
+            counters->peak_frame_depth.store(depth, std::memory_order_relaxed);
+        }
+    }
+}
+
+inline void count_frame_pop() {
+    if (thread_ref_counters* counters = g_ref_counters) {
+        counters->frame_depth.store(counters->frame_depth.load(std::memory_order_relaxed) - 1,
+                                    std::memory_order_relaxed);
+    }
+}
+
+WHATJNI_BASE_INLINE jobject pop_local_frame(jobject result) {
+    count_frame_pop();
+    if (batch* b = g_batch) {
+        forget_batched_receiver(b, nullptr);
+    }
+    return check_exception(get_env()->PopLocalFrame(result));
+}
+
+// PopLocalFrame may be called with an exception pending. The thread is attached, since it pushed the frame.
+WHATJNI_BASE_INLINE void pop_local_frame_unchecked() noexcept {
+    count_frame_pop();
+    if (batch* b = g_batch) {
+        forget_batched_receiver(b, nullptr);
+    }
+    g_env->PopLocalFrame(nullptr);
+}
+
+}  // namespace whatjni
+
+#endif  // WHATJNI_BASE_INLINE_H
@@ -0,0 +1,87 @@
+#ifndef WHATJNI_BATCH_H
+#define WHATJNI_BATCH_H
+
+#include "whatjni/base.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace whatjni {
+
+class batch;
+
+// See base_inline.h.
+WHATJNI_BASE void forget_batched_receiver(batch* b, jobject obj) noexcept;
+
+// Called by initialize_thread(). The LocalRefs of a native method called from Java while the thread has a batch are
+// deleted when it returns, unseen by forget_batched_receiver(), so the batch stores every receiver from then on.
+WHATJNI_BASE void batch_entered_native_method(batch* b);
+
+// While an instance is in scope on the current thread, calls to void methods, other than nonvirtual calls, are recorded
+// instead of being made, then replayed by the Java class whatjni.runtime.BatchReplayer in a single call to Java. A loop
+// such as
+//
+//     whatjni::batch batch;
+//     for (double x : values) {
+//         statistics->addValue(x);
+//     }
+//
+// crosses from C++ to Java once per batch::capacity calls rather than once per call. Recorded calls are replayed when
+// the batch is full, when flush() is called, when the outermost batch goes out of scope, and before any method call
+// that returns a value, nonvirtual call or new_object(), so those observe the effects of the recorded calls. Field and
+// array accessors do not flush, so call flush() before accessing state the recorded calls modify.
+//
+// A Java exception thrown by a replayed call is thrown as jvm_exception from whatever flushed; the calls recorded after
+// it are discarded. If the batch goes out of scope because of a C++ exception, the calls it still holds are discarded.
+// Nested instances join the outermost one. The whatjni runtime jar must be on the classpath; see new_native_callback.
+class WHATJNI_BASE batch {
+    batch* outer_;
+    int uncaught_exceptions_;
+    std::vector<jint> methods_;
+    std::vector<jlong> primitives_;
+    jobjectArray objects_ = nullptr;  // global ref
+    jsize num_objects_ = 0;
+    jobject receiver_ = nullptr;  // of the last call recorded since the last flush, unless forgotten
+    uint64_t receiver_deletions_ = 0;
+    bool entered_native_method_ = false;
+public:
+    static const jsize capacity = 1024;
+
+    batch();
+    ~batch() noexcept(false);
+
+    batch(const batch&) = delete;
+    batch& operator=(const batch&) = delete;
+
+    void flush();
+
+    // Called by call_method_a<void> and call_static_method_a<void>; obj is null for static methods.
+    void record(jclass clazz, jobject obj, jmethodID method, const jvalue* args);
+
+private:
+    void add_object(jobject obj);
+
+    friend void forget_batched_receiver(batch* b, jobject obj) noexcept;
+    friend void batch_entered_native_method(batch* b);
+};
+
+// Makes b the current thread's batch, returning the previous one. Used by batch.
+WHATJNI_BASE batch* set_current_batch(batch* b);
+
+// Counts GlobalRefs and WeakGlobalRefs deleted on any thread. Used by batch.
+WHATJNI_BASE uint64_t get_num_global_ref_deletions();
+
+// While in scope, void calls on the current thread are made immediately, even inside a batch. For calls that must not
+// be deferred or discarded along with a batch, e.g. those whatjni makes itself.
+struct suspend_batch {
+    batch* b;
+    suspend_batch(): b(set_current_batch(nullptr)) {}
+    ~suspend_batch() { set_current_batch(b); }
+
+    suspend_batch(const suspend_batch&) = delete;
+    suspend_batch& operator=(const suspend_batch&) = delete;
+};
+
+}  // namespace whatjni
+
+#endif  // WHATJNI_BATCH_H
@@ -0,0 +1,99 @@
+#ifndef WHATJNI_BINDING_H
+#define WHATJNI_BINDING_H
+
+#include "whatjni/base.h"
+
+#include <atomic>
+
+namespace whatjni {
+
+// Resolves every class, method and field binding registered so far. Throws jvm_exception if any cannot be found.
+WHATJNI_BASE void resolve_all_bindings();
+
+// Classes, methods and fields referenced by generated bindings. Each binding is a static object that links itself into
+// a process-wide registry during static initialization, so that resolve_all_bindings() can look them all up in one pass,
+// typically right after initialize_vm(). A binding that has not been resolved that way is resolved the first time it is
+// used. Once resolved, get() is a plain load.
+class WHATJNI_BASE class_binding {
+    friend void resolve_all_bindings();
+    friend class class_cache;
+
+    const char* name_;
+    std::atomic<jclass> clazz_;
+    class_binding* next_;
+public:
+    explicit class_binding(const char* name);
+
+    class_binding(const class_binding&) = delete;
+    class_binding& operator=(const class_binding&) = delete;
+
+    // Global ref to the class.
+    jclass get() {
+        jclass clazz = clazz_.load(std::memory_order_acquire);
+        return clazz ? clazz : resolve();
+    }
+
+    const char* get_name() const { return name_; }
+
+    jclass resolve();
+};
+
+class WHATJNI_BASE method_binding {
+    friend void resolve_all_bindings();
+    friend class class_cache;
+
+    class_binding& clazz_;
+    const char* name_;
+    const char* signature_;
+    bool is_static_;
+    std::atomic<jmethodID> id_;
+    method_binding* next_;
+public:
+    method_binding(class_binding& clazz, const char* name, const char* signature, bool is_static);
+
+    method_binding(const method_binding&) = delete;
+    method_binding& operator=(const method_binding&) = delete;
+
+    jmethodID get() {
+        jmethodID id = id_.load(std::memory_order_acquire);
+        return id ? id : resolve();
+    }
+
+    class_binding& get_class() const { return clazz_; }
+    const char* get_name() const { return name_; }
+    const char* get_signature() const { return signature_; }
+
+    jmethodID resolve();
+};
+
+class WHATJNI_BASE field_binding {
+    friend void resolve_all_bindings();
+    friend class class_cache;
+
+    class_binding& clazz_;
+    const char* name_;
+    const char* signature_;
+    bool is_static_;
+    std::atomic<jfieldID> id_;
+    field_binding* next_;
+public:
+    field_binding(class_binding& clazz, const char* name, const char* signature, bool is_static);
+
+    field_binding(const field_binding&) = delete;
+    field_binding& operator=(const field_binding&) = delete;
+
+    jfieldID get() {
+        jfieldID id = id_.load(std::memory_order_acquire);
+        return id ? id : resolve();
+    }
+
+    class_binding& get_class() const { return clazz_; }
+    const char* get_name() const { return name_; }
+    const char* get_signature() const { return signature_; }
+
+    jfieldID resolve();
+};
+
+}  // namespace whatjni
+
+#endif  // WHATJNI_BINDING_H
@@ -0,0 +1,25 @@
+#ifndef WHATJNI_CALLBACK_H
+#define WHATJNI_CALLBACK_H
+
+#include "whatjni/base.h"
+
+#include <functional>
+
+namespace whatjni {
+
+typedef std::function<void(jobject result, jthrowable error)> native_callback_function;
+
+// Returns a LocalRef to a new whatjni.runtime.NativeCallback, which implements both Runnable and
+// BiConsumer<Object, Throwable>, so it can be passed to Java APIs taking either. The first call to run() or accept(),
+// on whichever Java thread makes it, calls function with LocalRefs to the arguments, which are null for run(); later
+// calls do nothing. function is destroyed after it is called. If Java never calls the callback, function is never
+// destroyed.
+//
+// A jvm_exception thrown by function is rethrown in Java; any other exception is thrown as a RuntimeException.
+//
+// The whatjni runtime jar, the :runtime project, must be on the classpath.
+WHATJNI_BASE jobject new_native_callback(native_callback_function function);
+
+}  // namespace whatjni
+
+#endif  // WHATJNI_CALLBACK_H
@@ -0,0 +1,98 @@
+#ifndef WHATJNI_COMPLETABLE_FUTURE_H
+#define WHATJNI_COMPLETABLE_FUTURE_H
+
+#include "whatjni/executor.h"
+#include "whatjni/ref.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+
+#if WHATJNI_LANG >= 202002L
+    #include <coroutine>
+#endif
+
+namespace java {
+namespace util {
+namespace concurrent {
+
+class CompletableFuture;
+
+}  // namespace concurrent
+}  // namespace util
+}  // namespace java
+
+namespace whatjni {
+
+typedef std::function<void(jobject result, std::exception_ptr error)> completion_function;
+
+// Calls function once the java.util.concurrent.CompletableFuture completes, with a ref to its result, or with a
+// jvm_exception holding the exception that completed it exceptionally. No thread blocks waiting for it.
+//
+// If ex is null, function is called on the Java thread that completes the future or, if it is already complete, on
+// the calling thread. Otherwise it is called on one of ex's workers. Either way, result is a ref that is only valid
+// until function returns. The whatjni runtime jar must be on the classpath; see new_native_callback.
+WHATJNI_BASE void when_complete(jobject future, executor* ex, completion_function function);
+
+#if WHATJNI_LANG >= 202002L
+
+// Awaits a CompletableFuture in a coroutine. co_await evaluates to a global_ref<T> to the future's result or throws
+// jvm_exception. The coroutine resumes on the thread that calls the completion function, as described for
+// when_complete().
+template <typename T = java::lang::Object>
+class future_awaiter {
+    global_ref<java::util::concurrent::CompletableFuture> future_;
+    executor* executor_;
+    global_ref<T> result_;
+    std::exception_ptr error_;
+    std::atomic<bool> one_finished_{false};
+public:
+    future_awaiter(const ref<java::util::concurrent::CompletableFuture>& future, executor* ex)
+        : future_(future), executor_(ex) {}
+
+    bool await_ready() const { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        // Whichever of the completion function and await_suspend finishes second resumes the coroutine. If the future
+        // is already complete, when_complete calls the function on this thread before returning, so await_suspend
+        // resumes the coroutine by returning false, rather than the function resuming it nested in a call from Java.
+        //
+        // The awaiter may be destroyed, along with the coroutine, as soon as the coroutine resumes, so nothing touches
+        // it after the exchange that might let it resume. That includes future_, whose GlobalRef would be deleted
+        // while when_complete still used it, so pass a LocalRef of this thread's own.
+        auto resume = [this, handle](jobject result, std::exception_ptr error) {
+            result_ = global_ref<T>((T*) result);
+            error_ = error;
+            if (one_finished_.exchange(true, std::memory_order_acq_rel)) {
+                handle.resume();
+            }
+        };
+        local_ref<java::util::concurrent::CompletableFuture> future(future_);
+        when_complete((jobject) future.operator->(), executor_, resume);
+        return !one_finished_.exchange(true, std::memory_order_acq_rel);
+    }
+
+    global_ref<T> await_resume() {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        return std::move(result_);
+    }
+};
+
+// co_await on(future, ex) resumes the coroutine on one of ex's workers.
+template <typename T = java::lang::Object>
+future_awaiter<T> on(const ref<java::util::concurrent::CompletableFuture>& future, executor* ex) {
+    return future_awaiter<T>(future, ex);
+}
+
+// co_await future resumes the coroutine on the thread that completes the future.
+inline future_awaiter<> operator co_await(const ref<java::util::concurrent::CompletableFuture>& future) {
+    return future_awaiter<>(future, nullptr);
+}
+
+#endif  // WHATJNI_LANG >= 202002L
+
+}  // namespace whatjni
+
+#endif  // WHATJNI_COMPLETABLE_FUTURE_H
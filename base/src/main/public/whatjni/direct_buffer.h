@@ -0,0 +1,73 @@
+#ifndef WHATJNI_DIRECT_BUFFER_H
+#define WHATJNI_DIRECT_BUFFER_H
+
+#include "whatjni/ref.h"
+
+#include <cstddef>
+#include <vector>
+
+#if WHATJNI_LANG >= 202002L
+    #include <span>
+#endif
+
+namespace java {
+namespace nio {
+
+class ByteBuffer;
+
+}  // namespace nio
+}  // namespace java
+
+namespace whatjni {
+
+// A direct java.nio.ByteBuffer together with the native memory it is a view of. Neither Java nor C++ copies the memory.
+//
+// A direct_buffer holds a ref to the ByteBuffer, so it is a LocalRef or GlobalRef depending on where the direct_buffer
+// resides, like any ref<T>. For a buffer allocated by Java, e.g. with ByteBuffer.allocateDirect, that ref keeps the
+// memory alive, so data() is valid for as long as the direct_buffer exists.
+//
+// A buffer created by wrap() does not own the memory it views; the memory must outlive not only the direct_buffer but
+// every ref to the ByteBuffer that Java code might still hold. Wrapped buffers use the native byte order so that Java's
+// typed views, e.g. asLongBuffer, agree with C++.
+class WHATJNI_BASE direct_buffer {
+    ref<java::nio::ByteBuffer> buffer_;
+    std::byte* data_ = nullptr;
+    size_t size_ = 0;
+public:
+    direct_buffer() {}
+
+    // Throws jvm_error if the ByteBuffer is not direct.
+    explicit direct_buffer(const ref<java::nio::ByteBuffer>& buffer);
+
+    static direct_buffer wrap(void* data, size_t size);
+    template <typename T> static direct_buffer wrap(std::vector<T>& data) {
+        return wrap(data.data(), data.size() * sizeof(T));
+    }
+#if WHATJNI_LANG >= 202002L
+    static direct_buffer wrap(std::span<std::byte> data) {
+        return wrap(data.data(), data.size());
+    }
+#endif
+
+    const ref<java::nio::ByteBuffer>& get_buffer() const { return buffer_; }
+
+    std::byte* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // The memory viewed as elements of type T, which the caller ensures are suitably aligned.
+    template <typename T> T* data_as() const { return reinterpret_cast<T*>(data_); }
+    template <typename T> size_t size_as() const { return size_ / sizeof(T); }
+
+#if WHATJNI_LANG >= 202002L
+    std::span<std::byte> as_span() const {
+        return std::span<std::byte>(data_, size_);
+    }
+    template <typename T> std::span<T> as_span_of() const {
+        return std::span<T>(data_as<T>(), size_as<T>());
+    }
+#endif
+};
+
+}  // namespace whatjni
+
+#endif  // WHATJNI_DIRECT_BUFFER_H
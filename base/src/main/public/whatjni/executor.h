@@ -0,0 +1,67 @@
+#ifndef WHATJNI_EXECUTOR_H
+#define WHATJNI_EXECUTOR_H
+
+#include "whatjni/base.h"
+
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace whatjni {
+
+// A pool of worker threads that are attached to the JVM once, when the executor is created, rather than by every task.
+// Each worker has its own lock-free queue; submit() distributes tasks across the queues and idle workers steal from
+// busy ones.
+//
+// Each task runs in its own local frame, so local refs it creates are deleted when it returns. A task that produces a
+// Java object should return it as a global_ref<T> or otherwise as a global ref. A jvm_exception, or any other exception,
+// thrown by a task is rethrown by std::future::get().
+//
+// Workers are attached with the given attach_options, each with the name suffixed by its index. Unless they are daemon
+// threads, the executor must be destroyed before shutdown_vm(). Destroying the executor runs any tasks still queued,
+// then detaches and joins the workers.
+class WHATJNI_BASE executor {
+public:
+    struct task {
+        virtual ~task() {}
+        virtual void run() = 0;
+    };
+
+    explicit executor(size_t num_threads = 0, const attach_options& options = default_attach_options());
+    ~executor();
+
+    executor(const executor&) = delete;
+    executor& operator=(const executor&) = delete;
+
+    // Zero in the constructor means one worker per hardware thread.
+    size_t get_num_threads() const;
+
+    template <typename F> auto submit(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+        auto t = std::make_unique<packaged_task<R>>(std::forward<F>(f));
+        auto future = t->task_.get_future();
+        post(std::move(t));
+        return future;
+    }
+
+    // Lower overhead than submit() for tasks whose result and exceptions are of no interest; an exception thrown by the
+    // task is discarded.
+    void post(std::unique_ptr<task> t);
+
+    static attach_options default_attach_options();
+
+private:
+    template <typename R> struct packaged_task: task {
+        template <typename F> explicit packaged_task(F&& f): task_(std::forward<F>(f)) {}
+        void run() override { task_(); }
+        std::packaged_task<R()> task_;
+    };
+
+    struct impl;
+    std::unique_ptr<impl> impl_;
+};
+
+}  // namespace whatjni
+
+#endif  // WHATJNI_EXECUTOR_H
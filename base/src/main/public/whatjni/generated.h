@@ -4,8 +4,12 @@
 // Included by automatically at the beginning of generated JNI bindings
 
 #include "whatjni/array.h"
+#include "whatjni/binding.h"
+#include "whatjni/metrics.h"
+#include "whatjni/native_peer.h"
 #include "whatjni/no_destroy.h"
 #include "whatjni/ref.h"
+#include "whatjni/trace.h"
 #include <limits>
 
 #endif  // WHATJNI_GENERATED_H
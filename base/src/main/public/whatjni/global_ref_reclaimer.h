@@ -0,0 +1,28 @@
+#ifndef WHATJNI_GLOBAL_REF_RECLAIMER_H
+#define WHATJNI_GLOBAL_REF_RECLAIMER_H
+
+#include "whatjni/base.h"
+
+#include <chrono>
+#include <memory>
+
+namespace whatjni {
+
+// A thread, attached to the JVM as a daemon, that calls delete_queued_global_refs() periodically for as long as the
+// reclaimer exists. See deferred_global_ref_deletion.
+class WHATJNI_BASE global_ref_reclaimer {
+public:
+    explicit global_ref_reclaimer(std::chrono::milliseconds interval = std::chrono::milliseconds(10));
+    ~global_ref_reclaimer();
+
+    global_ref_reclaimer(const global_ref_reclaimer&) = delete;
+    global_ref_reclaimer& operator=(const global_ref_reclaimer&) = delete;
+
+private:
+    struct impl;
+    std::unique_ptr<impl> impl_;
+};
+
+}  // namespace whatjni
+
+#endif  // WHATJNI_GLOBAL_REF_RECLAIMER_H
@@ -0,0 +1,59 @@
+#ifndef WHATJNI_MAPPED_FILE_H
+#define WHATJNI_MAPPED_FILE_H
+
+#include "whatjni/direct_buffer.h"
+
+#include <string>
+
+namespace whatjni {
+
+// Maps a file into memory and exposes the same pages to Java as a direct ByteBuffer, so neither side copies the file.
+// Errors from the operating system are thrown as std::system_error.
+//
+// Java might still reference the ByteBuffer, or a slice or duplicate of it, when the mapped_file is destroyed. Since
+// unmapping the pages would then crash the JVM on its next access, the mapping is instead retired and only unmapped
+// once the garbage collector has collected the buffer. reclaim() unmaps retired mappings that are no longer reachable;
+// it is also called whenever a mapped_file is created or destroyed.
+class WHATJNI_BASE mapped_file {
+    std::byte* data_ = nullptr;
+    size_t size_ = 0;
+    bool writable_ = false;
+    global_ref<java::nio::ByteBuffer> buffer_;
+    jobject root_ = nullptr;  // weak global ref to the buffer returned by NewDirectByteBuffer
+public:
+    enum mode {
+        read_only,
+        read_write,
+    };
+
+    mapped_file() {}
+    mapped_file(const std::string& path, mode access);
+    ~mapped_file();
+
+    mapped_file(mapped_file&& rhs);
+    mapped_file& operator=(mapped_file&& rhs);
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    std::byte* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool is_writable() const { return writable_; }
+
+    // Created the first time it is requested. For a read_only mapping, this is a read-only view, so Java code cannot
+    // write to pages that are not writable.
+    const ref<java::nio::ByteBuffer>& get_buffer();
+
+    // Writes modified pages of a read_write mapping back to the file.
+    void flush();
+
+    // Unmaps the mapping now unless Java might still reference it.
+    void close();
+
+    // Unmaps retired mappings whose buffers have been garbage collected. Returns the number still retired.
+    static size_t reclaim();
+};
+
+}  // namespace whatjni
+
+#endif  // WHATJNI_MAPPED_FILE_H
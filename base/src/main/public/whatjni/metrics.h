@@ -0,0 +1,102 @@
+#ifndef WHATJNI_METRICS_H
+#define WHATJNI_METRICS_H
+
+#include "whatjni/trace.h"
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace whatjni {
+
+// Counts the calls to one generated binding and their latencies. Latencies are kept in a histogram in the style of
+// HdrHistogram: each power of two nanoseconds is divided into 8 linear buckets, so a bucket's bounds are within 12.5%
+// of any latency in it, up to about 18 minutes.
+//
+// Generated bindings have one of these each, with static storage duration, when the bindings are generated with the
+// metrics option:
+//
+//     whatjni {
+//         metrics = true
+//     }
+//
+// Each call updates a few counters shared by every thread calling the binding, so the metrics are better suited to
+// finding which bindings are hot than to leaving enabled in production.
+struct binding_metrics {
+    static const int NUM_BUCKETS = 304;
+
+    call_site site;
+    std::atomic<uint64_t> total_nanos{0};
+    std::atomic<uint64_t> max_nanos{0};
+    std::atomic<uint64_t> buckets[NUM_BUCKETS] = {};  // their sum is the number of calls
+
+    explicit binding_metrics(const call_site& site);
+    ~binding_metrics();
+
+    binding_metrics(const binding_metrics&) = delete;
+    binding_metrics& operator=(const binding_metrics&) = delete;
+};
+
+WHATJNI_BASE void register_binding_metrics(binding_metrics* metrics);
+WHATJNI_BASE void unregister_binding_metrics(binding_metrics* metrics);
+WHATJNI_BASE void record_binding_call(binding_metrics* metrics, uint64_t nanos);
+
+inline binding_metrics::binding_metrics(const call_site& site): site(site) {
+    register_binding_metrics(this);
+}
+
+inline binding_metrics::~binding_metrics() {
+    unregister_binding_metrics(this);
+}
+
+// Times a call from construction to destruction, including calls that throw.
+class metrics_scope {
+    binding_metrics* metrics_;
+    uint64_t start_;
+public:
+    explicit metrics_scope(binding_metrics* metrics): metrics_(metrics), start_(trace_clock()) {}
+    ~metrics_scope() {
+        record_binding_call(metrics_, trace_clock() - start_);
+    }
+
+    metrics_scope(const metrics_scope&) = delete;
+    metrics_scope& operator=(const metrics_scope&) = delete;
+};
+
+struct latency_bucket {
+    uint64_t upper_bound_nanos;  // exclusive
+    uint64_t count;
+};
+
+struct binding_metrics_snapshot {
+    call_site site;
+    uint64_t calls = 0;
+    uint64_t total_nanos = 0;
+    uint64_t max_nanos = 0;
+
+    // Upper bounds of the buckets holding each percentile, but no more than max_nanos.
+    uint64_t p50_nanos = 0;
+    uint64_t p90_nanos = 0;
+    uint64_t p99_nanos = 0;
+    uint64_t p999_nanos = 0;
+
+    std::vector<latency_bucket> buckets;  // only those that are not empty, in ascending order
+};
+
+// The metrics of every binding called at least once. Bindings may be called while the snapshot is taken, so its
+// counters may disagree slightly with one another.
+WHATJNI_BASE std::vector<binding_metrics_snapshot> metrics_snapshot();
+
+// Writes metrics_snapshot() in the Prometheus text exposition format: a counter of calls and a summary of latencies in
+// seconds for each binding, labelled by Java class, member, descriptor and operation.
+WHATJNI_BASE void write_metrics(std::ostream& out);
+
+}  // namespace whatjni
+
+#define WHATJNI_METRICS_CALL(op, class_name, name, descriptor)                                  \
+    static ::whatjni::binding_metrics whatjni_binding_metrics(                                  \
+        ::whatjni::call_site{ op, class_name, name, descriptor });                              \
+    ::whatjni::metrics_scope whatjni_metrics_scope(&whatjni_binding_metrics)
+
+#endif  // WHATJNI_METRICS_H
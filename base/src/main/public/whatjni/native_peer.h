@@ -0,0 +1,69 @@
+#ifndef WHATJNI_NATIVE_PEER_H
+#define WHATJNI_NATIVE_PEER_H
+
+#include "whatjni/base.h"
+
+#include <memory>
+#include <typeinfo>
+
+namespace whatjni {
+
+// A native peer is a C++ object owned by a Java object, which holds a handle to it in a long field. Handles index a
+// process-wide table of slots, so finding the peer from the Java object takes one field read and no lock, rather than
+// a lookup keyed by the object's identity hash code.
+//
+// Each slot counts the peers it has held. A handle records the count, or generation, of the peer it was issued for, so
+// a handle whose peer has since been destroyed finds nothing, rather than whichever peer now occupies its slot. Zero
+// is never a handle, so a zeroed field has no peer.
+typedef void (*native_peer_deleter)(void* peer);
+
+WHATJNI_BASE jlong insert_native_peer(void* peer, const std::type_info& type, native_peer_deleter deleter);
+
+// Null if the handle is zero, if its peer has been destroyed or if its peer is not of the given type.
+WHATJNI_BASE void* find_native_peer(jlong handle, const std::type_info& type);
+
+// Destroys the handle's peer on the calling thread. Returns false, doing nothing, if the handle is zero or its peer
+// was already destroyed. Destroying a peer while another thread uses it is as undefined as for any other object.
+WHATJNI_BASE bool erase_native_peer(jlong handle);
+
+WHATJNI_BASE size_t get_num_native_peers();
+
+template <typename T>
+jlong new_native_peer(std::unique_ptr<T> peer) {
+    jlong handle = insert_native_peer(peer.get(), typeid(T), [](void* p) {
+        delete (T*) p;
+    });
+    peer.release();
+    return handle;
+}
+
+template <typename T>
+T* get_native_peer(jlong handle) {
+    return (T*) find_native_peer(handle, typeid(T));
+}
+
+// Stores the handle in field, a long field of obj, taking ownership of its peer and destroying any peer obj had
+// before. Once obj is phantom reachable, the peer is destroyed on the thread of a java.lang.ref.Cleaner, unless
+// destroy_native_peer() destroyed it first. If this throws, the peer is destroyed.
+//
+// The whatjni runtime jar must be on the classpath; see new_native_callback.
+WHATJNI_BASE void attach_native_peer(jobject obj, jfieldID field, jlong handle);
+
+// Destroys obj's peer now, if it has one, and zeroes field.
+WHATJNI_BASE void destroy_native_peer(jobject obj, jfieldID field);
+
+template <typename T>
+T* attach_native_peer(jobject obj, jfieldID field, std::unique_ptr<T> peer) {
+    T* result = peer.get();
+    attach_native_peer(obj, field, new_native_peer(std::move(peer)));
+    return result;
+}
+
+template <typename T>
+T* get_native_peer(jobject obj, jfieldID field) {
+    return get_native_peer<T>(get_field<jlong>(obj, field));
+}
+
+}  // namespace whatjni
+
+#endif  // WHATJNI_NATIVE_PEER_H
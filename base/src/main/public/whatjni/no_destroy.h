@@ -1,6 +1,9 @@
 #ifndef WHATJNI_NO_DESTROY_H
 #define WHATJNI_NO_DESTROY_H
 
+#include <new>
+#include <utility>
+
 namespace whatjni {
 
 template <class T>
@@ -2,6 +2,7 @@
 #define WHATJNI_REF_H
 
 #include "whatjni/base.h"
+#include "whatjni/no_destroy.h"
 
 #include <string>
 #include <unordered_set>
@@ -25,12 +26,17 @@ void static_assert_instanceof(T*, java::lang::Object*) {}
 
 static const struct {} own_ref;
 
+template <typename T> class local_ref;
+template <typename T> class global_ref;
+
 // T* is actually a JNI LocalRef or GlobalRef, selected automatically depending on whether a given ref<T> is resides on
 // the stack or not. Except for some specific exceptions, generally T may be an incomplete type, i.e. only forward
 // declared.
 template <typename T>
 class ref {
     template <typename U> friend class ref;
+    template <typename U> friend class local_ref;
+    template <typename U> friend class global_ref;
     T* obj = nullptr;
 public:
     typedef T Class;
@@ -89,8 +95,16 @@ public:
         move_auto_ref((jobject*) &obj, (jobject*) &rhs.obj);
     }
 
+    // The kind of a local_ref or global_ref does not depend on where it resides, so it is copied rather than moved.
+    template<typename U> ref(const local_ref<U>& rhs): ref((const ref<U>&) rhs) {}
+    template<typename U> ref(const global_ref<U>& rhs): ref((const ref<U>&) rhs) {}
+    template<typename U> ref(local_ref<U>&& rhs): ref((const ref<U>&) rhs) {}
+    template<typename U> ref(global_ref<U>&& rhs): ref((const ref<U>&) rhs) {}
+
     ~ref() {
-        delete_auto_ref((jobject*) &obj);
+        if (obj) {
+            delete_auto_ref((jobject*) &obj);
+        }
     }
 
     ref& operator=(std::nullptr_t) {
@@ -125,6 +139,12 @@ public:
         move_auto_ref((jobject*) &obj, (jobject*) &rhs.obj);
         return *this;
     }
+    template<typename U> ref& operator=(const local_ref<U>& rhs) {
+        return *this = (const ref<U>&) rhs;
+    }
+    template<typename U> ref& operator=(const global_ref<U>& rhs) {
+        return *this = (const ref<U>&) rhs;
+    }
 
     T* operator->() const {
         return obj;
@@ -139,6 +159,18 @@ public:
     template <typename U> bool operator!=(const ref<U>& rhs) const {
         return !is_same_object((jobject) obj, (jobject) rhs.obj);
     }
+    template <typename U> bool operator==(const local_ref<U>& rhs) const {
+        return *this == (const ref<U>&) rhs;
+    }
+    template <typename U> bool operator!=(const local_ref<U>& rhs) const {
+        return *this != (const ref<U>&) rhs;
+    }
+    template <typename U> bool operator==(const global_ref<U>& rhs) const {
+        return *this == (const ref<U>&) rhs;
+    }
+    template <typename U> bool operator!=(const global_ref<U>& rhs) const {
+        return *this != (const ref<U>&) rhs;
+    }
 };
 
 template <typename T> bool operator==(const ref<T>& lhs, std::nullptr_t) {
@@ -154,10 +186,335 @@ template <typename T> bool operator!=(std::nullptr_t, const ref<T>& rhs) {
     return rhs;
 }
 
+// A ref that is always a JNI LocalRef, wherever it resides, so copying, moving and destroying it need not check whether
+// it is on the stack. It converts to const ref<T>&, so it may be passed wherever one is expected, but it is not a
+// ref<T>, so it cannot bind to a ref<T>& whose assignment would treat it as of the kind where it resides. Like any
+// LocalRef, it must not outlive the native method call or local frame in which it was created, nor be used by another
+// thread.
+template <typename T>
+class local_ref {
+    template <typename U> friend class local_ref;
+    ref<T> ref_;  // holds a LocalRef, which this deletes, so ref<T> never treats it as of the kind where it resides
+public:
+    typedef T Class;
+
+    local_ref() {}
+    local_ref(std::nullptr_t) {}
+
+    local_ref(jobject rhs, decltype(own_ref)): ref_(rhs, own_ref) {}
+    local_ref(T* rhs, decltype(own_ref)): ref_(rhs, own_ref) {}
+
+    local_ref(T* rhs) {
+        ref_.obj = (T*) new_local_ref((jobject) rhs);
+    }
+    template <typename U> local_ref(U* rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        ref_.obj = (T*) new_local_ref((jobject) rhs);
+    }
+
+    local_ref(const local_ref& rhs) {
+        ref_.obj = (T*) new_local_ref((jobject) rhs.ref_.obj);
+    }
+    template <typename U> local_ref(const ref<U>& rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        ref_.obj = (T*) new_local_ref((jobject) rhs.obj);
+    }
+    template <typename U> local_ref(const local_ref<U>& rhs): local_ref((const ref<U>&) rhs) {}
+    template <typename U> local_ref(const global_ref<U>& rhs): local_ref((const ref<U>&) rhs) {}
+
+    local_ref(local_ref&& rhs) {
+        ref_.obj = rhs.ref_.obj;
+        rhs.ref_.obj = nullptr;
+    }
+    template <typename U> local_ref(local_ref<U>&& rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        ref_.obj = rhs.ref_.obj;
+        rhs.ref_.obj = nullptr;
+    }
+
+    ~local_ref() {
+        if (ref_.obj) {
+            delete_local_ref((jobject) ref_.obj);
+            ref_.obj = nullptr;
+        }
+    }
+
+    local_ref& operator=(std::nullptr_t) {
+        reset(nullptr);
+        return *this;
+    }
+    local_ref& operator=(const local_ref& rhs) {
+        if (this != &rhs) {
+            reset((T*) new_local_ref((jobject) rhs.ref_.obj));
+        }
+        return *this;
+    }
+    template <typename U> local_ref& operator=(const ref<U>& rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        reset((T*) new_local_ref((jobject) rhs.obj));
+        return *this;
+    }
+    template <typename U> local_ref& operator=(const local_ref<U>& rhs) {
+        return *this = (const ref<U>&) rhs;
+    }
+    template <typename U> local_ref& operator=(const global_ref<U>& rhs) {
+        return *this = (const ref<U>&) rhs;
+    }
+
+    local_ref& operator=(local_ref&& rhs) {
+        if (this != &rhs) {
+            reset(rhs.ref_.obj);
+            rhs.ref_.obj = nullptr;
+        }
+        return *this;
+    }
+    template <typename U> local_ref& operator=(local_ref<U>&& rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        reset(rhs.ref_.obj);
+        rhs.ref_.obj = nullptr;
+        return *this;
+    }
+
+    operator const ref<T>&() const {
+        return ref_;
+    }
+
+    T* operator->() const {
+        return ref_.obj;
+    }
+    operator bool() const {
+        return ref_.obj;
+    }
+
+    template <typename U> bool operator==(const ref<U>& rhs) const {
+        return ref_ == rhs;
+    }
+    template <typename U> bool operator!=(const ref<U>& rhs) const {
+        return ref_ != rhs;
+    }
+    template <typename U> bool operator==(const local_ref<U>& rhs) const {
+        return ref_ == rhs;
+    }
+    template <typename U> bool operator!=(const local_ref<U>& rhs) const {
+        return ref_ != rhs;
+    }
+    template <typename U> bool operator==(const global_ref<U>& rhs) const {
+        return ref_ == rhs;
+    }
+    template <typename U> bool operator!=(const global_ref<U>& rhs) const {
+        return ref_ != rhs;
+    }
+
+private:
+    void reset(T* rhs) {
+        if (ref_.obj) {
+            delete_local_ref((jobject) ref_.obj);
+        }
+        ref_.obj = rhs;
+    }
+};
+
+// A ref that is always a JNI GlobalRef, wherever it resides, so copying, moving and destroying it need not check whether
+// it is on the stack. Like local_ref, it converts to const ref<T>& but cannot bind to a ref<T>&. It may be shared
+// between threads.
+template <typename T>
+class global_ref {
+    template <typename U> friend class global_ref;
+    ref<T> ref_;  // holds a GlobalRef, which this deletes, so ref<T> never treats it as of the kind where it resides
+public:
+    typedef T Class;
+
+    global_ref() {}
+    global_ref(std::nullptr_t) {}
+
+    global_ref(jobject rhs, decltype(own_ref)): ref_(rhs, own_ref) {}
+    global_ref(T* rhs, decltype(own_ref)): ref_(rhs, own_ref) {}
+
+    global_ref(T* rhs) {
+        ref_.obj = (T*) new_global_ref((jobject) rhs);
+    }
+    template <typename U> global_ref(U* rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        ref_.obj = (T*) new_global_ref((jobject) rhs);
+    }
+
+    global_ref(const global_ref& rhs) {
+        ref_.obj = (T*) new_global_ref((jobject) rhs.ref_.obj);
+    }
+    template <typename U> global_ref(const ref<U>& rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        ref_.obj = (T*) new_global_ref((jobject) rhs.obj);
+    }
+    template <typename U> global_ref(const local_ref<U>& rhs): global_ref((const ref<U>&) rhs) {}
+    template <typename U> global_ref(const global_ref<U>& rhs): global_ref((const ref<U>&) rhs) {}
+
+    global_ref(global_ref&& rhs) {
+        ref_.obj = rhs.ref_.obj;
+        rhs.ref_.obj = nullptr;
+    }
+    template <typename U> global_ref(global_ref<U>&& rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        ref_.obj = rhs.ref_.obj;
+        rhs.ref_.obj = nullptr;
+    }
+
+    ~global_ref() {
+        if (ref_.obj) {
+            delete_global_ref((jobject) ref_.obj);
+            ref_.obj = nullptr;
+        }
+    }
+
+    global_ref& operator=(std::nullptr_t) {
+        reset(nullptr);
+        return *this;
+    }
+    global_ref& operator=(const global_ref& rhs) {
+        if (this != &rhs) {
+            reset((T*) new_global_ref((jobject) rhs.ref_.obj));
+        }
+        return *this;
+    }
+    template <typename U> global_ref& operator=(const ref<U>& rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        reset((T*) new_global_ref((jobject) rhs.obj));
+        return *this;
+    }
+    template <typename U> global_ref& operator=(const local_ref<U>& rhs) {
+        return *this = (const ref<U>&) rhs;
+    }
+    template <typename U> global_ref& operator=(const global_ref<U>& rhs) {
+        return *this = (const ref<U>&) rhs;
+    }
+
+    global_ref& operator=(global_ref&& rhs) {
+        if (this != &rhs) {
+            reset(rhs.ref_.obj);
+            rhs.ref_.obj = nullptr;
+        }
+        return *this;
+    }
+    template <typename U> global_ref& operator=(global_ref<U>&& rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        reset(rhs.ref_.obj);
+        rhs.ref_.obj = nullptr;
+        return *this;
+    }
+
+    operator const ref<T>&() const {
+        return ref_;
+    }
+
+    T* operator->() const {
+        return ref_.obj;
+    }
+    operator bool() const {
+        return ref_.obj;
+    }
+
+    template <typename U> bool operator==(const ref<U>& rhs) const {
+        return ref_ == rhs;
+    }
+    template <typename U> bool operator!=(const ref<U>& rhs) const {
+        return ref_ != rhs;
+    }
+    template <typename U> bool operator==(const local_ref<U>& rhs) const {
+        return ref_ == rhs;
+    }
+    template <typename U> bool operator!=(const local_ref<U>& rhs) const {
+        return ref_ != rhs;
+    }
+    template <typename U> bool operator==(const global_ref<U>& rhs) const {
+        return ref_ == rhs;
+    }
+    template <typename U> bool operator!=(const global_ref<U>& rhs) const {
+        return ref_ != rhs;
+    }
+
+private:
+    void reset(T* rhs) {
+        if (ref_.obj) {
+            delete_global_ref((jobject) ref_.obj);
+        }
+        ref_.obj = rhs;
+    }
+};
+
+template <typename T> bool operator==(const local_ref<T>& lhs, std::nullptr_t) {
+    return !lhs;
+}
+template <typename T> bool operator!=(const local_ref<T>& lhs, std::nullptr_t) {
+    return lhs;
+}
+template <typename T> bool operator==(std::nullptr_t, const local_ref<T>& rhs) {
+    return !rhs;
+}
+template <typename T> bool operator!=(std::nullptr_t, const local_ref<T>& rhs) {
+    return rhs;
+}
+
+template <typename T> bool operator==(const global_ref<T>& lhs, std::nullptr_t) {
+    return !lhs;
+}
+template <typename T> bool operator!=(const global_ref<T>& lhs, std::nullptr_t) {
+    return lhs;
+}
+template <typename T> bool operator==(std::nullptr_t, const global_ref<T>& rhs) {
+    return !rhs;
+}
+template <typename T> bool operator!=(std::nullptr_t, const global_ref<T>& rhs) {
+    return rhs;
+}
+
+// Creates a new Java string each time it is evaluated. In a loop, prefer WHATJNI_LITERAL or WHATJNI_INTERNED.
 inline ref<java::lang::String> operator ""_j(const char* str, std::size_t size) {
     return ref<java::lang::String>(str, size);
 }
 
+// A Java string created from a C++ string literal the first time the expression is evaluated and held as a GlobalRef,
+// which is never deleted, for every evaluation after that. Evaluating it again returns a borrowed ref and does not call
+// into the JVM. The WHATJNI_INTERNED form uses the canonical String.intern() instance.
+#define WHATJNI_LITERAL(str) WHATJNI_STRING_CONSTANT(str, false)
+#define WHATJNI_INTERNED(str) WHATJNI_STRING_CONSTANT(str, true)
+
+#define WHATJNI_STRING_CONSTANT(str, intern)                                                                           \
+    ([]() -> const ::whatjni::ref<::java::lang::String>& {                                                             \
+        static ::whatjni::no_destroy<::whatjni::global_ref<::java::lang::String>> value(                               \
+            (jobject) ::whatjni::new_global_utf8_string("" str, sizeof(str) - 1, intern), ::whatjni::own_ref);         \
+        return value.get();                                                                                            \
+    }())
+
+#if WHATJNI_LANG >= 202002L
+
+template <std::size_t N>
+struct string_literal {
+    char chars[N];
+
+    constexpr string_literal(const char (&str)[N]) {
+        for (std::size_t i = 0; i < N; ++i) {
+            chars[i] = str[i];
+        }
+    }
+};
+
+// Like WHATJNI_INTERNED, e.g. "hello"_jc, with one GlobalRef for each distinct literal.
+template <string_literal S>
+const ref<java::lang::String>& operator ""_jc() {
+    static no_destroy<global_ref<java::lang::String>> value(
+        (jobject) new_global_utf8_string(S.chars, sizeof(S.chars) - 1, true), own_ref);
+    return value.get();
+}
+
+#endif
+
+inline std::string to_std_string(const ref<java::lang::String>& str) {
+    return to_std_string((jstring) str.operator->());
+}
+
+inline std::u16string to_u16string(const ref<java::lang::String>& str) {
+    return to_u16string((jstring) str.operator->());
+}
+
 template<typename T> struct by_value {
     std::size_t operator()(const ref<T>& r) const {
         return (std::size_t) get_hash_code((jobject) r.operator->());
@@ -188,6 +545,9 @@ template<typename T> struct hash<::whatjni::ref<T>> {
     }
 };
 
+template<typename T> struct hash<::whatjni::local_ref<T>>: hash<::whatjni::ref<T>> {};
+template<typename T> struct hash<::whatjni::global_ref<T>>: hash<::whatjni::ref<T>> {};
+
 }  // namespace std
 
 #endif  // WHATJNI_REF_H
@@ -0,0 +1,159 @@
+#ifndef WHATJNI_SHARED_REF_H
+#define WHATJNI_SHARED_REF_H
+
+#include "whatjni/ref.h"
+
+#include <atomic>
+
+namespace whatjni {
+
+template <typename T>
+struct shared_ref_block {
+    std::atomic<size_t> count{1};
+    global_ref<T> obj;
+
+    explicit shared_ref_block(jobject global): obj(global, own_ref) {}
+};
+
+// Shares one JNI GlobalRef between all its copies, which count references to it atomically, like std::shared_ptr.
+// Copying or destroying a shared_ref does not call into the JVM, except that destroying the last copy deletes the
+// GlobalRef. Copies may be passed between and used on any threads. Prefer it to ref<T> for Java objects held in
+// containers that are copied often; creating a shared_ref creates its GlobalRef as usual, as does converting a
+// shared_ref<U> to a shared_ref<T> of another class, since each GlobalRef is held by a global_ref<T> of its class.
+//
+// get() borrows the GlobalRef as a ref<T>, which may be passed to generated methods without creating another JNI ref.
+// Except for some specific exceptions, generally T may be an incomplete type, i.e. only forward declared.
+template <typename T>
+class shared_ref {
+    template <typename U> friend class shared_ref;
+    shared_ref_block<T>* block = nullptr;
+
+    static shared_ref_block<T>* new_block(jobject obj) {
+        return obj ? new shared_ref_block<T>(new_global_ref(obj)) : nullptr;
+    }
+
+    void acquire() const {
+        if (block) {
+            block->count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void release() {
+        if (block && block->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete block;
+        }
+        block = nullptr;
+    }
+
+public:
+    typedef T Class;
+
+    shared_ref() {}
+    shared_ref(std::nullptr_t) {}
+
+    template <typename U> shared_ref(const ref<U>& rhs) {
+        static_assert_instanceof((U*) nullptr, (T*) nullptr);
+        block = new_block((jobject) rhs.operator->());
+    }
+    template <typename U> shared_ref(const local_ref<U>& rhs): shared_ref((const ref<U>&) rhs) {}
+    template <typename U> shared_ref(const global_ref<U>& rhs): shared_ref((const ref<U>&) rhs) {}
+
+    shared_ref(const shared_ref& rhs): block(rhs.block) {
+        acquire();
+    }
+    template <typename U> shared_ref(const shared_ref<U>& rhs): shared_ref(rhs.get()) {}
+
+    shared_ref(shared_ref&& rhs): block(rhs.block) {
+        rhs.block = nullptr;
+    }
+    template <typename U> shared_ref(shared_ref<U>&& rhs): shared_ref(rhs.get()) {
+        rhs = nullptr;
+    }
+
+    ~shared_ref() {
+        release();
+    }
+
+    shared_ref& operator=(std::nullptr_t) {
+        release();
+        return *this;
+    }
+    shared_ref& operator=(const shared_ref& rhs) {
+        rhs.acquire();
+        release();
+        block = rhs.block;
+        return *this;
+    }
+    template <typename U> shared_ref& operator=(const shared_ref<U>& rhs) {
+        return *this = shared_ref(rhs);
+    }
+
+    shared_ref& operator=(shared_ref&& rhs) {
+        if (this != &rhs) {
+            release();
+            block = rhs.block;
+            rhs.block = nullptr;
+        }
+        return *this;
+    }
+    template <typename U> shared_ref& operator=(shared_ref<U>&& rhs) {
+        return *this = shared_ref(std::move(rhs));
+    }
+
+    // The borrowed ref is only valid while this shared_ref holds the GlobalRef.
+    const ref<T>& get() const {
+        static const ref<T> null;
+        return block ? (const ref<T>&) block->obj : null;
+    }
+    operator const ref<T>&() const {
+        return get();
+    }
+
+    T* operator->() const {
+        return block ? block->obj.operator->() : nullptr;
+    }
+    operator bool() const {
+        return block;
+    }
+
+    // The number of shared_refs sharing the GlobalRef, which other threads may be changing.
+    size_t use_count() const {
+        return block ? block->count.load(std::memory_order_relaxed) : 0;
+    }
+
+    template <typename U> bool operator==(const shared_ref<U>& rhs) const {
+        return (const void*) block == (const void*) rhs.block ||
+               is_same_object((jobject) operator->(), (jobject) rhs.operator->());
+    }
+    template <typename U> bool operator!=(const shared_ref<U>& rhs) const {
+        return !(*this == rhs);
+    }
+};
+
+template <typename T> bool operator==(const shared_ref<T>& lhs, std::nullptr_t) {
+    return !lhs;
+}
+template <typename T> bool operator!=(const shared_ref<T>& lhs, std::nullptr_t) {
+    return lhs;
+}
+template <typename T> bool operator==(std::nullptr_t, const shared_ref<T>& rhs) {
+    return !rhs;
+}
+template <typename T> bool operator!=(std::nullptr_t, const shared_ref<T>& rhs) {
+    return rhs;
+}
+
+}  // namespace whatjni
+
+namespace std {
+
+template<typename T> struct hash<::whatjni::shared_ref<T>> {
+    ::whatjni::by_identity<T> hasher;
+    std::size_t operator()(const ::whatjni::shared_ref<T>& r) const {
+        return hasher(r.get());
+    }
+};
+
+}  // namespace std
+
+#endif  // WHATJNI_SHARED_REF_H
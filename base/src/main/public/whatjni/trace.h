@@ -0,0 +1,99 @@
+#ifndef WHATJNI_TRACE_H
+#define WHATJNI_TRACE_H
+
+#include "whatjni/base.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+namespace whatjni {
+
+enum trace_op {
+    TRACE_CALL_METHOD,
+    TRACE_CALL_STATIC_METHOD,
+    TRACE_NEW_OBJECT,
+    TRACE_GET_FIELD,
+    TRACE_SET_FIELD,
+    TRACE_GET_STATIC_FIELD,
+    TRACE_SET_STATIC_FIELD,
+};
+
+// Describes the Java member a generated binding accesses. Each binding has one, with static storage duration, so an
+// event only needs to record its address.
+struct call_site {
+    trace_op op;
+    const char* class_name;  // internal form, e.g. "java/lang/String"
+    const char* name;        // "<init>" for constructors
+    const char* descriptor;
+};
+
+// E.g. "call_method" for TRACE_CALL_METHOD.
+WHATJNI_BASE const char* get_trace_op_name(trace_op op);
+
+#ifdef WHATJNI_INLINE
+extern std::atomic<bool> g_tracing;
+inline bool is_tracing() {
+    return g_tracing.load(std::memory_order_relaxed);
+}
+#else
+WHATJNI_BASE bool is_tracing();
+#endif
+
+// Monotonic, in nanoseconds. On Linux this is CLOCK_MONOTONIC, so events line up with samples from
+// "perf record -k CLOCK_MONOTONIC".
+inline uint64_t trace_clock() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+WHATJNI_BASE void record_trace_event(const call_site* site, uint64_t start, uint64_t end);
+
+// Records a JNI crossing from construction to destruction, if tracing was started when it was constructed.
+class trace_scope {
+    const call_site* site_;
+    uint64_t start_;
+public:
+    explicit trace_scope(const call_site* site): site_(is_tracing() ? site : nullptr), start_(0) {
+        if (site_) {
+            start_ = trace_clock();
+        }
+    }
+
+    ~trace_scope() {
+        if (site_) {
+            record_trace_event(site_, start_, trace_clock());
+        }
+    }
+
+    trace_scope(const trace_scope&) = delete;
+    trace_scope& operator=(const trace_scope&) = delete;
+};
+
+// Starts recording the JNI crossings made by generated bindings. Each thread records into its own ring buffer of
+// events_per_thread events, overwriting its oldest events once full, so recording never blocks or allocates after a
+// thread's first event. Only code compiled with WHATJNI_TRACE defined records events; otherwise generated bindings
+// contain no tracing code at all.
+WHATJNI_BASE void start_tracing(size_t events_per_thread = 65536);
+WHATJNI_BASE void stop_tracing();
+
+// Discards recorded events, including those of threads that have exited.
+WHATJNI_BASE void clear_trace();
+
+// Writes the recorded events in the Chrome trace_event JSON format, which chrome://tracing and Perfetto can open. Each
+// crossing is a complete event named by its Java class and member, on the thread that made it. Events may be written
+// while tracing continues; events being overwritten meanwhile are left out.
+WHATJNI_BASE void write_chrome_trace(std::ostream& out);
+
+}  // namespace whatjni
+
+#ifdef WHATJNI_TRACE
+    #define WHATJNI_TRACE_CALL(op, class_name, name, descriptor)                                  \
+        static const ::whatjni::call_site whatjni_call_site = { op, class_name, name, descriptor }; \
+        ::whatjni::trace_scope whatjni_trace_scope(&whatjni_call_site)
+#else
+    #define WHATJNI_TRACE_CALL(op, class_name, name, descriptor)
+#endif
+
+#endif  // WHATJNI_TRACE_H
@@ -30,9 +30,9 @@ struct TypeTraits {
         return Class::get_signature();
     }
 
-    // Class for this type. Only present for types that are classes, i.e. not for primitive types.
+    // Class for this type, as a global ref. Only present for types that are classes, i.e. not for primitive types.
     static jclass get_class() {
-        static jclass clazz = find_class(signature_to_class_name(get_signature()).c_str());
+        static jclass clazz = class_cache::get(signature_to_class_name(get_signature()).c_str());
         return clazz;
     }
 
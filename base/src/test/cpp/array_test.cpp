@@ -2,6 +2,9 @@
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <list>
+
 namespace whatjni {
 
 namespace {
@@ -56,6 +59,44 @@ TEST_F(ArrayTest, set_then_get_int_element) {
     })
 }
 
+TEST_F(ArrayTest, write_then_read_region) {
+    jint written[] = { 1, 2 };
+    int_array->write_region(1, 2, written);
+
+    jint read[3];
+    int_array->read_region(0, 3, read);
+    EXPECT_EQ(read[0], 0);
+    EXPECT_EQ(read[1], 1);
+    EXPECT_EQ(read[2], 2);
+}
+
+TEST_F(ArrayTest, read_region_out_of_range_throws) {
+    jint read[4];
+    EXPECT_THROW(int_array->read_region(0, 4, read), jvm_exception);
+}
+
+TEST_F(ArrayTest, new_array_from_vector) {
+    std::vector<jdouble> values(ARRAY_CHUNK_LENGTH * 2 + 1);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = i * 0.5;
+    }
+
+    auto array = new_array_from(values);
+    EXPECT_EQ(array->get_length(), jsize(values.size()));
+    EXPECT_EQ(array->to_vector(), values);
+}
+
+TEST_F(ArrayTest, new_array_from_non_contiguous_range) {
+    std::list<jshort> values;
+    for (jsize i = 0; i < ARRAY_CHUNK_LENGTH + 3; ++i) {
+        values.push_back(jshort(i));
+    }
+
+    auto array = new_array_from(values);
+    auto copy = array->to_vector();
+    EXPECT_TRUE(std::equal(values.begin(), values.end(), copy.begin(), copy.end()));
+}
+
 TEST_F(ArrayTest, access_mapped_elements) {
     jsize len = int_array->get_length();
     {
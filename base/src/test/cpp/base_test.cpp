@@ -2,6 +2,10 @@
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
 namespace whatjni {
 
 struct BaseTest: testing::Test {
@@ -21,6 +25,18 @@ TEST_F(BaseTest, get_super_class) {
     EXPECT_TRUE(is_assignable_from(clazz1, clazz2));
 }
 
+TEST_F(BaseTest, class_cache_returns_same_global_ref) {
+    auto clazz = class_cache::get("java/awt/Point");
+    EXPECT_EQ(get_object_ref_type(clazz), JNIGlobalRefType);
+    EXPECT_TRUE(is_same_object(clazz, find_class("java/awt/Point")));
+    EXPECT_EQ(class_cache::get("java/awt/Point"), clazz);
+}
+
+TEST_F(BaseTest, class_cache_loads_array_classes) {
+    auto clazz = class_cache::get("[Ljava/lang/String;");
+    EXPECT_TRUE(is_same_object(clazz, find_class("[Ljava/lang/String;")));
+}
+
 TEST_F(BaseTest, alloc_object) {
     auto clazz = find_class("java/awt/Point");
     jobject obj = alloc_object(clazz);
@@ -72,6 +88,57 @@ TEST_F(BaseTest, new_weak_ref_then_delete_weak_ref) {
     delete_weak_global_ref(obj2);
 }
 
+TEST_F(BaseTest, ref_stats_counts_global_refs_and_frame_depth) {
+    auto clazz = find_class("java/awt/Point");
+    jobject obj = alloc_object(clazz);
+    ref_counts before = ref_stats().total;
+
+    jobject global = new_global_ref(obj);
+    push_local_frame(4);
+    push_local_frame(4);
+    pop_local_frame();
+    pop_local_frame();
+
+    ref_counts during = ref_stats().total;
+    EXPECT_EQ(during.global_refs_created - before.global_refs_created, 1u);
+    EXPECT_EQ(during.live_global_refs() - before.live_global_refs(), 1);
+    EXPECT_GE(during.peak_frame_depth, 3u);
+
+    delete_global_ref(global);
+    ref_counts after = ref_stats().total;
+    EXPECT_EQ(after.live_global_refs(), before.live_global_refs());
+}
+
+TEST_F(BaseTest, ref_stats_include_exited_threads) {
+    uint64_t before = ref_stats().total.local_refs_created;
+    std::thread thread([&] {
+        jstring str = new_utf8_string("counted");
+        delete_local_ref(str);
+    });
+    thread.join();
+    EXPECT_GT(ref_stats().total.local_refs_created, before);
+}
+
+TEST_F(BaseTest, get_live_ref_sites_reports_undeleted_global_ref) {
+    auto clazz = find_class("java/awt/Point");
+    jobject obj = alloc_object(clazz);
+
+    set_ref_site_tracking(true);
+    jobject global = new_global_ref(obj);
+    auto sites = get_live_ref_sites();
+    delete_global_ref(global);
+    auto sites_after = get_live_ref_sites();
+    set_ref_site_tracking(false);
+
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "GlobalRef %p", (void*) global);
+    auto has_site = [&](const std::vector<std::string>& v) {
+        return std::any_of(v.begin(), v.end(), [&](const std::string& s) { return s.rfind(prefix, 0) == 0; });
+    };
+    EXPECT_TRUE(has_site(sites));
+    EXPECT_FALSE(has_site(sites_after));
+}
+
 TEST_F(BaseTest, auto_refs_on_stack_are_local_refs) {
     auto clazz = find_class("java/awt/Point");
     jobject obj = alloc_object(clazz);
@@ -218,6 +285,65 @@ TEST_F(BaseTest, call_static_method) {
     EXPECT_NE(result, 0);
 }
 
+TEST_F(BaseTest, call_static_method_with_arguments_of_each_width) {
+    auto clazz = find_class("java/lang/Math");
+
+    auto max_long_method_id = get_static_method_id(clazz, "max", "(JJ)J");
+    EXPECT_EQ(call_static_method<jlong>(clazz, max_long_method_id, jlong(1) << 40, jlong(2)), jlong(1) << 40);
+
+    auto max_float_method_id = get_static_method_id(clazz, "max", "(FF)F");
+    EXPECT_EQ(call_static_method<jfloat>(clazz, max_float_method_id, jfloat(1.5), jfloat(-2)), 1.5f);
+
+    auto max_int_method_id = get_static_method_id(clazz, "max", "(II)I");
+    EXPECT_EQ(call_static_method<jint>(clazz, max_int_method_id, jint(7), jint(-3)), 7);
+}
+
+TEST_F(BaseTest, deferred_exception_check_throws_at_end_of_scope) {
+    jarray array = new_primitive_array<jint>(3);
+
+    auto set_out_of_range = [&]() {
+        deferred_exception_check deferred;
+        set_array_element(array, 0, jint(1));
+        set_array_element(array, 3, jint(2));
+    };
+    EXPECT_THROW(set_out_of_range(), jvm_exception);
+    EXPECT_EQ(get_array_element<jint>(array, 0), 1);
+}
+
+TEST_F(BaseTest, deferred_exception_check_check_throws_immediately) {
+    jarray array = new_primitive_array<jint>(3);
+
+    deferred_exception_check deferred;
+    set_array_element(array, 3, jint(2));
+    EXPECT_THROW(deferred.check(), jvm_exception);
+}
+
+TEST_F(BaseTest, to_std_string_ascii) {
+    jstring str = new_utf8_string("hello");
+    EXPECT_EQ(to_std_string(str), "hello");
+    EXPECT_EQ(to_u16string(str), u"hello");
+}
+
+TEST_F(BaseTest, to_std_string_converts_modified_utf8) {
+    std::u16string chars(u"a\0b\u20AC\U0001F600c", 7);
+    jstring str = new_string((const jchar*) chars.data(), jsize(chars.size()));
+    EXPECT_EQ(to_std_string(str), std::string("a\0b\xE2\x82\xAC\xF0\x9F\x98\x80" "c", 11));
+    EXPECT_EQ(to_u16string(str), chars);
+}
+
+TEST_F(BaseTest, to_utf8_into_buffer) {
+    jstring str = new_utf8_string("hello \xE2\x82\xAC");
+
+    char small[4];
+    EXPECT_GE(to_utf8(str, small, sizeof(small)), sizeof(small));
+
+    char buffer[16];
+    size_t length = to_utf8(str, buffer, sizeof(buffer));
+    ASSERT_LT(length, sizeof(buffer));
+    EXPECT_EQ(std::string(buffer, length), "hello \xE2\x82\xAC");
+    EXPECT_EQ(buffer[length], 0);
+}
+
 TEST_F(BaseTest, push_and_pop_local_frames_preserving_one_ref) {
     push_local_frame(1000);
 
@@ -304,6 +430,18 @@ TEST_F(BaseTest, utf8_string_with_internal_null) {
     release_string_chars(str, (const jchar*) chars);
 }
 
+TEST_F(BaseTest, utf8_string_fast_path_without_null_terminator) {
+    jstring str = new_utf8_string("HelloWorld", 5);
+    EXPECT_EQ(to_std_string(str), "Hello");
+}
+
+TEST_F(BaseTest, long_utf8_string_slow_path) {
+    std::string utf8 = std::string(100, 'a') + "\xf0\x9f\x9c\x81" + std::string(100, 'b');
+    EXPECT_EQ(to_std_string(new_utf8_string(utf8.c_str())), utf8);
+    EXPECT_EQ(to_std_string(new_utf8_string(utf8.data(), jsize(utf8.size()))), utf8);
+    EXPECT_EQ(to_std_string(new_utf8_string(utf8.c_str() + 1)), utf8.substr(1));
+}
+
 TEST_F(BaseTest, new_primitive_array) {
     jarray array = new_primitive_array<jint>(3);
     EXPECT_NE(array, nullptr);
@@ -331,4 +469,110 @@ TEST_F(BaseTest, get_and_release_array_elements) {
     release_array_elements(array, elements, 0);
 }
 
+TEST_F(BaseTest, scoped_local_frame_pop_escapes_result) {
+    jobject escaped;
+    {
+        scoped_local_frame frame(4);
+        ensure_local_capacity(8);
+        new_utf8_string("deleted");
+        escaped = frame.pop(new_utf8_string("escaped"));
+    }
+    EXPECT_EQ(get_object_ref_type(escaped), JNILocalRefType);
+    EXPECT_EQ(to_std_string((jstring) escaped), "escaped");
+}
+
+TEST_F(BaseTest, local_frames_leave_deferred_exception_pending) {
+    jarray array = new_primitive_array<jint>(3);
+
+    auto set_out_of_range = [&]() {
+        deferred_exception_check deferred;
+        scoped_local_frame frame(4);
+        rolling_local_frame frames(1);
+        set_array_element(array, 3, jint(1));
+    };
+    EXPECT_THROW(set_out_of_range(), jvm_exception);
+}
+
+TEST_F(BaseTest, rolling_local_frame_carries_ref_across_frames) {
+    auto clazz = find_class("java/lang/String");
+    auto concat_method = get_method_id(clazz, "concat", "(Ljava/lang/String;)Ljava/lang/String;");
+
+    jobject result;
+    {
+        rolling_local_frame frames(10, 3);
+        jobject accumulated = new_utf8_string("");
+        for (int i = 0; i < 95; ++i) {
+            jobject next = call_method<jobject>(accumulated, concat_method, new_utf8_string("x"));
+            accumulated = frames.next(next);
+        }
+        result = frames.pop(accumulated);
+    }
+    EXPECT_EQ(to_std_string((jstring) result), std::string(95, 'x'));
+}
+
+TEST_F(BaseTest, attaches_thread_on_first_use) {
+    std::string result;
+    std::thread thread([&] {
+        jstring str = new_utf8_string("attached");
+        result = to_std_string(str);
+        delete_local_ref(str);
+    });
+    thread.join();
+    EXPECT_EQ(result, "attached");
+}
+
+namespace {
+
+// Constructed before the thread's first call into the JVM, so destroyed after the thread is detached.
+struct calls_jvm_on_exit {
+    jint* error = nullptr;
+
+    ~calls_jvm_on_exit() {
+        if (!error) {
+            return;
+        }
+        try {
+            delete_local_ref(new_utf8_string("late"));
+        } catch (jvm_error& e) {
+            *error = e.error();
+        }
+    }
+};
+
+thread_local calls_jvm_on_exit t_calls_jvm_on_exit;
+
+}  // namespace anonymous
+
+TEST_F(BaseTest, does_not_reattach_exiting_thread) {
+    jint error = JNI_OK;
+    std::thread thread([&] {
+        t_calls_jvm_on_exit.error = &error;
+        delete_local_ref(new_utf8_string("attached"));
+    });
+    thread.join();
+    EXPECT_EQ(error, JNI_EDETACHED);
+}
+
+TEST_F(BaseTest, scoped_attach_names_thread) {
+    std::string name;
+    std::thread thread([&] {
+        attach_options options;
+        options.daemon = true;
+        options.name = "whatjni-test";
+        scoped_attach attach(options);
+
+        auto thread_class = find_class("java/lang/Thread");
+        auto current_thread_method = get_static_method_id(thread_class, "currentThread", "()Ljava/lang/Thread;");
+        auto get_name_method = get_method_id(thread_class, "getName", "()Ljava/lang/String;");
+        jobject current = call_static_method<jobject>(thread_class, current_thread_method);
+        jstring str = (jstring) call_method<jobject>(current, get_name_method);
+        name = to_std_string(str);
+        delete_local_ref(str);
+        delete_local_ref(current);
+        delete_local_ref(thread_class);
+    });
+    thread.join();
+    EXPECT_EQ(name, "whatjni-test");
+}
+
 }  // namespace whatjni
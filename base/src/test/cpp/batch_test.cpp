@@ -0,0 +1,139 @@
+#include "whatjni/batch.h"
+
+#include "gtest/gtest.h"
+
+namespace whatjni {
+
+struct BatchTest: testing::Test {
+    BatchTest() {
+        push_local_frame(16);
+        point_class = find_class("java/awt/Point");
+        point = new_object(point_class, get_method_id(point_class, "<init>", "(II)V"), jint(0), jint(0));
+        translate_method = get_method_id(point_class, "translate", "(II)V");
+        x_field = get_field_id(point_class, "x", "I");
+    }
+
+    ~BatchTest() {
+        pop_local_frame();
+    }
+
+    jclass point_class;
+    jobject point;
+    jmethodID translate_method;
+    jfieldID x_field;
+};
+
+TEST_F(BatchTest, records_void_calls_until_flushed) {
+    batch b;
+    call_method<void>(point, translate_method, jint(1), jint(2));
+    call_method<void>(point, translate_method, jint(3), jint(4));
+    EXPECT_EQ(get_field<jint>(point, x_field), 0);
+
+    b.flush();
+    EXPECT_EQ(get_field<jint>(point, x_field), 4);
+}
+
+TEST_F(BatchTest, replays_when_out_of_scope_and_when_full) {
+    {
+        batch b;
+        for (int i = 0; i < batch::capacity * 2 + 1; ++i) {
+            call_method<void>(point, translate_method, jint(1), jint(0));
+        }
+        EXPECT_EQ(get_field<jint>(point, x_field), batch::capacity * 2);
+    }
+    EXPECT_EQ(get_field<jint>(point, x_field), batch::capacity * 2 + 1);
+}
+
+TEST_F(BatchTest, call_returning_value_flushes) {
+    auto get_x_method = get_method_id(point_class, "getX", "()D");
+
+    batch b;
+    call_method<void>(point, translate_method, jint(5), jint(0));
+    EXPECT_EQ(call_method<jdouble>(point, get_x_method), 5);
+}
+
+TEST_F(BatchTest, passes_object_arguments) {
+    auto list_class = find_class("java/util/ArrayList");
+    jobject list = new_object(list_class, get_method_id(list_class, "<init>", "()V"));
+    auto add_method = get_method_id(list_class, "add", "(ILjava/lang/Object;)V");
+
+    {
+        batch b;
+        call_method<void>(list, add_method, jint(0), new_utf8_string("b"));
+        call_method<void>(list, add_method, jint(0), new_utf8_string("a"));
+    }
+
+    auto get_method = get_method_id(list_class, "get", "(I)Ljava/lang/Object;");
+    EXPECT_EQ(to_std_string((jstring) call_method<jobject>(list, get_method, jint(0))), "a");
+    EXPECT_EQ(to_std_string((jstring) call_method<jobject>(list, get_method, jint(1))), "b");
+}
+
+TEST_F(BatchTest, passes_primitive_arguments) {
+    auto double_point_class = find_class("java/awt/geom/Point2D$Double");
+    jobject double_point = new_object(double_point_class, get_method_id(double_point_class, "<init>", "()V"));
+    auto float_point_class = find_class("java/awt/geom/Point2D$Float");
+    jobject float_point = new_object(float_point_class, get_method_id(float_point_class, "<init>", "()V"));
+    auto bit_set_class = find_class("java/util/BitSet");
+    jobject bit_set = new_object(bit_set_class, get_method_id(bit_set_class, "<init>", "()V"));
+
+    {
+        batch b;
+        call_method<void>(double_point, get_method_id(double_point_class, "setLocation", "(DD)V"), jdouble(1.5),
+                          jdouble(-2.25));
+        call_method<void>(float_point, get_method_id(float_point_class, "setLocation", "(FF)V"), jfloat(0.5),
+                          jfloat(-4));
+        call_method<void>(bit_set, get_method_id(bit_set_class, "set", "(IZ)V"), jint(3), jboolean(JNI_TRUE));
+    }
+
+    EXPECT_EQ(get_field<jdouble>(double_point, get_field_id(double_point_class, "y", "D")), -2.25);
+    EXPECT_EQ(get_field<jfloat>(float_point, get_field_id(float_point_class, "x", "F")), 0.5f);
+    EXPECT_TRUE(call_method<jboolean>(bit_set, get_method_id(bit_set_class, "get", "(I)Z"), jint(3)));
+}
+
+TEST_F(BatchTest, replays_calls_on_each_receiver) {
+    jobject other = new_object(point_class, get_method_id(point_class, "<init>", "(II)V"), jint(0), jint(0));
+    auto thread_class = find_class("java/lang/Thread");
+    auto yield_method = get_static_method_id(thread_class, "yield", "()V");
+
+    {
+        batch b;
+        call_method<void>(point, translate_method, jint(1), jint(0));
+        call_method<void>(point, translate_method, jint(2), jint(0));
+        call_static_method<void>(thread_class, yield_method);
+        call_method<void>(point, translate_method, jint(4), jint(0));
+        call_method<void>(other, translate_method, jint(8), jint(0));
+        call_method<void>(point, translate_method, jint(16), jint(0));
+    }
+
+    EXPECT_EQ(get_field<jint>(point, x_field), 23);
+    EXPECT_EQ(get_field<jint>(other, x_field), 8);
+}
+
+TEST_F(BatchTest, does_not_mistake_receiver_reusing_deleted_handle) {
+    jobject other = new_object(point_class, get_method_id(point_class, "<init>", "(II)V"), jint(0), jint(0));
+
+    {
+        batch b;
+        for (jobject obj : { point, other, point }) {
+            jobject local = new_local_ref(obj);
+            call_method<void>(local, translate_method, jint(1), jint(0));
+            delete_local_ref(local);
+        }
+    }
+
+    EXPECT_EQ(get_field<jint>(point, x_field), 2);
+    EXPECT_EQ(get_field<jint>(other, x_field), 1);
+}
+
+TEST_F(BatchTest, throws_exception_from_replayed_call) {
+    auto thread_class = find_class("java/lang/Thread");
+    auto sleep_method = get_static_method_id(thread_class, "sleep", "(J)V");
+
+    batch b;
+    call_static_method<void>(thread_class, sleep_method, jlong(-1));
+    call_method<void>(point, translate_method, jint(1), jint(0));
+    EXPECT_THROW(b.flush(), jvm_exception);
+    EXPECT_EQ(get_field<jint>(point, x_field), 0);
+}
+
+}  // namespace whatjni
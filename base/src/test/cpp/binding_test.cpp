@@ -0,0 +1,44 @@
+#include "whatjni/binding.h"
+
+#include "gtest/gtest.h"
+
+namespace whatjni {
+
+namespace {
+
+class_binding point_class("java/awt/Point");
+field_binding x_field(point_class, "x", "I", false);
+method_binding get_x_method(point_class, "getX", "()D", false);
+
+class_binding system_class("java/lang/System");
+method_binding nano_time_method(system_class, "nanoTime", "()J", true);
+
+}  // namespace anonymous
+
+struct BindingTest: testing::Test {
+    BindingTest() {
+        push_local_frame(16);
+    }
+
+    ~BindingTest() {
+        pop_local_frame();
+    }
+};
+
+TEST_F(BindingTest, class_binding_is_global_ref) {
+    jclass clazz = point_class.get();
+    EXPECT_NE(clazz, nullptr);
+    EXPECT_EQ(get_object_ref_type(clazz), JNIGlobalRefType);
+    EXPECT_EQ(point_class.get(), clazz);
+}
+
+TEST_F(BindingTest, resolve_all_bindings) {
+    resolve_all_bindings();
+
+    jobject obj = alloc_object(point_class.get());
+    set_field(obj, x_field.get(), jint(1));
+    EXPECT_EQ(call_method<jdouble>(obj, get_x_method.get()), 1.0);
+    EXPECT_NE(call_static_method<jlong>(system_class.get(), nano_time_method.get()), 0);
+}
+
+}  // namespace whatjni
@@ -0,0 +1,142 @@
+#include "whatjni/completable_future.h"
+
+#include "gtest/gtest.h"
+
+#include <future>
+
+namespace whatjni {
+
+struct CompletableFutureTest: testing::Test {
+    CompletableFutureTest() {
+        push_local_frame(16);
+        future_class = find_class("java/util/concurrent/CompletableFuture");
+        future = new_object(future_class, get_method_id(future_class, "<init>", "()V"));
+    }
+
+    ~CompletableFutureTest() {
+        pop_local_frame();
+    }
+
+    void complete(jobject value) {
+        call_method<jboolean>(future, get_method_id(future_class, "complete", "(Ljava/lang/Object;)Z"), value);
+    }
+
+    void complete_exceptionally(const char* message) {
+        auto exception_class = find_class("java/lang/IllegalStateException");
+        jobject exception = new_object(exception_class,
+                                       get_method_id(exception_class, "<init>", "(Ljava/lang/String;)V"),
+                                       new_utf8_string(message));
+        call_method<jboolean>(future, get_method_id(future_class, "completeExceptionally", "(Ljava/lang/Throwable;)Z"),
+                              exception);
+    }
+
+    jclass future_class;
+    jobject future;
+};
+
+TEST_F(CompletableFutureTest, calls_function_when_completed) {
+    std::string result;
+    when_complete(future, nullptr, [&](jobject value, std::exception_ptr error) {
+        EXPECT_FALSE(error);
+        result = to_std_string((jstring) value);
+    });
+    EXPECT_EQ(result, "");
+
+    complete(new_utf8_string("done"));
+    EXPECT_EQ(result, "done");
+}
+
+TEST_F(CompletableFutureTest, calls_function_immediately_if_already_completed) {
+    complete(new_utf8_string("done"));
+
+    std::string result;
+    when_complete(future, nullptr, [&](jobject value, std::exception_ptr) {
+        result = to_std_string((jstring) value);
+    });
+    EXPECT_EQ(result, "done");
+}
+
+TEST_F(CompletableFutureTest, passes_exception) {
+    std::string message;
+    when_complete(future, nullptr, [&](jobject value, std::exception_ptr error) {
+        EXPECT_EQ(value, nullptr);
+        try {
+            std::rethrow_exception(error);
+        } catch (const jvm_exception& e) {
+            message = e.get_message();
+        }
+    });
+
+    complete_exceptionally("failed");
+    EXPECT_EQ(message, "failed");
+}
+
+TEST_F(CompletableFutureTest, calls_function_on_executor) {
+    executor pool(2);
+    std::promise<std::string> promise;
+    when_complete(future, &pool, [&](jobject value, std::exception_ptr) {
+        promise.set_value(to_std_string((jstring) value));
+    });
+
+    complete(new_utf8_string("done"));
+    EXPECT_EQ(promise.get_future().get(), "done");
+}
+
+#if WHATJNI_LANG >= 202002L
+
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+TEST_F(CompletableFutureTest, co_await_resumes_on_completion) {
+    std::string result;
+    auto coroutine = [&](ref<java::util::concurrent::CompletableFuture> f) -> detached_task {
+        auto value = co_await f;
+        result = to_std_string((jstring) value.operator->());
+    };
+    coroutine(ref<java::util::concurrent::CompletableFuture>(new_local_ref(future), own_ref));
+    EXPECT_EQ(result, "");
+
+    complete(new_utf8_string("done"));
+    EXPECT_EQ(result, "done");
+}
+
+TEST_F(CompletableFutureTest, co_await_on_completed_future_resumes_without_nesting) {
+    complete(new_utf8_string("done"));
+
+    // Were each co_await resumed from within the completion function, every iteration would deepen the stack.
+    int count = 0;
+    auto coroutine = [&](ref<java::util::concurrent::CompletableFuture> f) -> detached_task {
+        for (int i = 0; i < 100000; ++i) {
+            auto value = co_await f;
+            count += value.operator->() != nullptr;
+        }
+    };
+    coroutine(ref<java::util::concurrent::CompletableFuture>(new_local_ref(future), own_ref));
+    EXPECT_EQ(count, 100000);
+}
+
+TEST_F(CompletableFutureTest, co_await_throws_jvm_exception) {
+    std::string message;
+    auto coroutine = [&](ref<java::util::concurrent::CompletableFuture> f) -> detached_task {
+        try {
+            co_await f;
+        } catch (const jvm_exception& e) {
+            message = e.get_message();
+        }
+    };
+    coroutine(ref<java::util::concurrent::CompletableFuture>(new_local_ref(future), own_ref));
+
+    complete_exceptionally("failed");
+    EXPECT_EQ(message, "failed");
+}
+
+#endif  // WHATJNI_LANG >= 202002L
+
+}  // namespace whatjni
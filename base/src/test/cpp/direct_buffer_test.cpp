@@ -0,0 +1,56 @@
+#include "whatjni/direct_buffer.h"
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+
+namespace whatjni {
+
+struct DirectBufferTest: testing::Test {
+    DirectBufferTest() {
+        push_local_frame(16);
+        buffer_class = find_class("java/nio/ByteBuffer");
+    }
+
+    ~DirectBufferTest() {
+        pop_local_frame();
+    }
+
+    jclass buffer_class;
+};
+
+TEST_F(DirectBufferTest, wraps_native_memory_without_copying) {
+    std::vector<int32_t> data = { 1, 2, 3 };
+    direct_buffer buffer = direct_buffer::wrap(data);
+    EXPECT_EQ(buffer.size(), 12);
+    EXPECT_EQ(buffer.data_as<int32_t>(), data.data());
+
+    jobject obj = (jobject) buffer.get_buffer().operator->();
+    auto get_int_method = get_method_id(buffer_class, "getInt", "(I)I");
+    EXPECT_EQ(call_method<jint>(obj, get_int_method, jint(4)), 2);
+
+    data[1] = 7;
+    EXPECT_EQ(call_method<jint>(obj, get_int_method, jint(4)), 7);
+}
+
+TEST_F(DirectBufferTest, views_buffer_allocated_by_java) {
+    auto allocate_direct_method = get_static_method_id(buffer_class, "allocateDirect", "(I)Ljava/nio/ByteBuffer;");
+    ref<java::nio::ByteBuffer> allocated(call_static_method<jobject>(buffer_class, allocate_direct_method, jint(8)),
+                                         own_ref);
+
+    direct_buffer buffer(allocated);
+    EXPECT_EQ(buffer.size(), 8);
+
+    auto put_method = get_method_id(buffer_class, "put", "(IB)Ljava/nio/ByteBuffer;");
+    delete_local_ref(call_method<jobject>((jobject) allocated.operator->(), put_method, jint(3), jbyte(42)));
+    EXPECT_EQ(buffer.data()[3], std::byte(42));
+}
+
+TEST_F(DirectBufferTest, heap_buffer_is_not_direct) {
+    auto allocate_method = get_static_method_id(buffer_class, "allocate", "(I)Ljava/nio/ByteBuffer;");
+    ref<java::nio::ByteBuffer> allocated(call_static_method<jobject>(buffer_class, allocate_method, jint(8)), own_ref);
+
+    EXPECT_THROW(direct_buffer buffer(allocated), jvm_error);
+}
+
+}  // namespace whatjni
@@ -0,0 +1,68 @@
+#include "whatjni/executor.h"
+#include "whatjni/ref.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <vector>
+
+namespace whatjni {
+
+struct ExecutorTest: testing::Test {
+    ExecutorTest() {
+        push_local_frame(16);
+    }
+
+    ~ExecutorTest() {
+        pop_local_frame();
+    }
+};
+
+TEST_F(ExecutorTest, runs_java_calls_on_workers) {
+    executor pool(4);
+    EXPECT_EQ(pool.get_num_threads(), 4);
+
+    std::vector<std::future<std::string>> results;
+    for (int i = 0; i < 100; ++i) {
+        results.push_back(pool.submit([i] {
+            jstring str = new_utf8_string(std::to_string(i).c_str());
+            return to_std_string(str);
+        }));
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(results[i].get(), std::to_string(i));
+    }
+}
+
+TEST_F(ExecutorTest, propagates_jvm_exception_through_future) {
+    executor pool(2);
+    auto future = pool.submit([] {
+        auto clazz = find_class("java/lang/Integer");
+        auto parse_int_method = get_static_method_id(clazz, "parseInt", "(Ljava/lang/String;)I");
+        return call_static_method<jint>(clazz, parse_int_method, new_utf8_string("not a number"));
+    });
+
+    try {
+        future.get();
+        FAIL();
+    } catch (const jvm_exception& e) {
+        EXPECT_EQ(e.get_message(), "For input string: \"not a number\"");
+    }
+}
+
+TEST_F(ExecutorTest, runs_tasks_submitted_by_tasks_and_queued_tasks_before_destruction) {
+    std::atomic<int> count{0};
+    {
+        executor pool(3);
+        for (int i = 0; i < 2000; ++i) {
+            pool.submit([&] {
+                pool.submit([&] { ++count; });
+                ++count;
+            });
+        }
+    }
+    EXPECT_EQ(count, 4000);
+}
+
+}  // namespace whatjni
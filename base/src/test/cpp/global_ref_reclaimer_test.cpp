@@ -0,0 +1,65 @@
+#include "whatjni/global_ref_reclaimer.h"
+#include "whatjni/ref.h"
+
+#include "gtest/gtest.h"
+
+#include <thread>
+
+namespace whatjni {
+
+namespace {
+
+struct Point;
+
+}  // namespace anonymous
+
+struct GlobalRefReclaimerTest: testing::Test {
+    GlobalRefReclaimerTest() {
+        push_local_frame(16);
+        delete_queued_global_refs();
+        clazz = find_class("java/awt/Point");
+        obj = (Point*) alloc_object(clazz);
+    }
+
+    ~GlobalRefReclaimerTest() {
+        pop_local_frame();
+    }
+
+    jclass clazz;
+    local_ref<Point> obj;
+};
+
+TEST_F(GlobalRefReclaimerTest, queues_deletions_in_scope) {
+    {
+        deferred_global_ref_deletion deferred;
+        for (int i = 0; i < 100; ++i) {
+            global_ref<Point> ref(obj);
+        }
+    }
+    EXPECT_EQ(get_num_queued_global_ref_deletions(), 100);
+    EXPECT_EQ(delete_queued_global_refs(), 100);
+    EXPECT_EQ(get_num_queued_global_ref_deletions(), 0);
+}
+
+TEST_F(GlobalRefReclaimerTest, queues_deletions_on_detached_thread) {
+    global_ref<Point> ref(obj);
+    std::thread thread([ref = std::move(ref)] {});
+    thread.join();
+
+    EXPECT_EQ(delete_queued_global_refs(), 1);
+}
+
+TEST_F(GlobalRefReclaimerTest, reclaimer_deletes_queued_refs) {
+    global_ref_reclaimer reclaimer(std::chrono::milliseconds(1));
+    {
+        deferred_global_ref_deletion deferred;
+        global_ref<Point> ref(obj);
+    }
+
+    for (int i = 0; i < 1000 && get_num_queued_global_ref_deletions(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(get_num_queued_global_ref_deletions(), 0);
+}
+
+}  // namespace whatjni
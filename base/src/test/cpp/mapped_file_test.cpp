@@ -0,0 +1,66 @@
+#include "whatjni/mapped_file.h"
+
+#include "gtest/gtest.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace whatjni {
+
+struct MappedFileTest: testing::Test {
+    MappedFileTest() {
+        push_local_frame(16);
+        buffer_class = find_class("java/nio/ByteBuffer");
+
+        path = (std::filesystem::temp_directory_path() / "whatjni_mapped_file_test.bin").string();
+        std::ofstream file(path, std::ios::binary);
+        file.write("abcdefgh", 8);
+    }
+
+    ~MappedFileTest() {
+        pop_local_frame();
+        std::filesystem::remove(path);
+    }
+
+    jclass buffer_class;
+    std::string path;
+};
+
+TEST_F(MappedFileTest, maps_file_read_only) {
+    mapped_file file(path, mapped_file::read_only);
+    ASSERT_EQ(file.size(), 8);
+    EXPECT_EQ(file.data()[2], std::byte('c'));
+
+    jobject buffer = (jobject) file.get_buffer().operator->();
+    EXPECT_EQ(get_direct_buffer_capacity(buffer), 8);
+    EXPECT_TRUE(call_method<jboolean>(buffer, get_method_id(buffer_class, "isReadOnly", "()Z")));
+    EXPECT_EQ(call_method<jbyte>(buffer, get_method_id(buffer_class, "get", "(I)B"), jint(3)), 'd');
+}
+
+TEST_F(MappedFileTest, java_writes_are_visible_to_cpp) {
+    mapped_file file(path, mapped_file::read_write);
+
+    jobject buffer = (jobject) file.get_buffer().operator->();
+    auto put_method = get_method_id(buffer_class, "put", "(IB)Ljava/nio/ByteBuffer;");
+    delete_local_ref(call_method<jobject>(buffer, put_method, jint(0), jbyte('z')));
+
+    EXPECT_EQ(file.data()[0], std::byte('z'));
+    file.flush();
+}
+
+TEST_F(MappedFileTest, missing_file_throws) {
+    EXPECT_THROW(mapped_file((path + ".missing"), mapped_file::read_only), std::system_error);
+}
+
+TEST_F(MappedFileTest, mapping_is_retired_while_java_references_buffer) {
+    mapped_file file(path, mapped_file::read_only);
+    ref<java::nio::ByteBuffer> buffer = file.get_buffer();
+
+    size_t retired = mapped_file::reclaim();
+    file.close();
+    EXPECT_EQ(mapped_file::reclaim(), retired + 1);
+    EXPECT_EQ(call_method<jbyte>((jobject) buffer.operator->(), get_method_id(buffer_class, "get", "(I)B"), jint(0)),
+              'a');
+}
+
+}  // namespace whatjni
@@ -0,0 +1,82 @@
+#include "whatjni/metrics.h"
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+namespace whatjni {
+
+struct MetricsTest: testing::Test {
+    MetricsTest() {
+        push_local_frame(16);
+        point_class = find_class("java/awt/Point");
+        point = new_object(point_class, get_method_id(point_class, "<init>", "(II)V"), jint(1), jint(2));
+        translate_method = get_method_id(point_class, "translate", "(II)V");
+    }
+
+    ~MetricsTest() {
+        pop_local_frame();
+    }
+
+    // Like a generated binding.
+    void translate(jint dx, jint dy) {
+        WHATJNI_METRICS_CALL(TRACE_CALL_METHOD, "java/awt/Point", "translate", "(II)V");
+        call_method<void>(point, translate_method, dx, dy);
+    }
+
+    const binding_metrics_snapshot* find(const std::vector<binding_metrics_snapshot>& snapshots) {
+        for (auto& snapshot : snapshots) {
+            if (std::string(snapshot.site.name) == "translate") {
+                return &snapshot;
+            }
+        }
+        return nullptr;
+    }
+
+    jclass point_class;
+    jobject point;
+    jmethodID translate_method;
+};
+
+TEST_F(MetricsTest, counts_calls_into_histogram) {
+    auto before = metrics_snapshot();
+    uint64_t calls_before = find(before) ? find(before)->calls : 0;
+
+    for (int i = 0; i < 100; ++i) {
+        translate(1, 1);
+    }
+
+    auto after = metrics_snapshot();
+    auto snapshot = find(after);
+    ASSERT_NE(snapshot, nullptr);
+    EXPECT_EQ(snapshot->calls - calls_before, 100u);
+    EXPECT_STREQ(snapshot->site.class_name, "java/awt/Point");
+
+    uint64_t bucketed = 0;
+    uint64_t previous_bound = 0;
+    for (auto& bucket : snapshot->buckets) {
+        EXPECT_GT(bucket.upper_bound_nanos, previous_bound);
+        previous_bound = bucket.upper_bound_nanos;
+        bucketed += bucket.count;
+    }
+    EXPECT_EQ(bucketed, snapshot->calls);
+
+    EXPECT_GT(snapshot->p50_nanos, 0u);
+    EXPECT_LE(snapshot->p50_nanos, snapshot->p99_nanos);
+    EXPECT_LE(snapshot->p99_nanos, snapshot->max_nanos);
+    EXPECT_LE(snapshot->max_nanos, snapshot->total_nanos);
+}
+
+TEST_F(MetricsTest, writes_prometheus_text) {
+    translate(1, 1);
+
+    std::ostringstream out;
+    write_metrics(out);
+    std::string text = out.str();
+    EXPECT_NE(text.find("# TYPE whatjni_binding_calls_total counter"), std::string::npos);
+    EXPECT_NE(text.find("whatjni_binding_calls_total{class=\"java/awt/Point\",member=\"translate\","
+                        "descriptor=\"(II)V\",op=\"call_method\"}"), std::string::npos);
+    EXPECT_NE(text.find("quantile=\"0.99\""), std::string::npos);
+}
+
+}  // namespace whatjni
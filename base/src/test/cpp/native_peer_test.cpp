@@ -0,0 +1,122 @@
+#include "whatjni/native_peer.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace whatjni {
+
+namespace {
+
+struct counted_peer {
+    std::atomic<int>* destroyed;
+    int value;
+
+    counted_peer(std::atomic<int>* destroyed, int value): destroyed(destroyed), value(value) {}
+    ~counted_peer() {
+        ++*destroyed;
+    }
+};
+
+struct other_peer {
+};
+
+}  // namespace anonymous
+
+struct NativePeerTest: testing::Test {
+    NativePeerTest() {
+        push_local_frame(16);
+        clazz = find_class("java/util/concurrent/atomic/AtomicLong");
+        field = get_field_id(clazz, "value", "J");
+        obj = alloc_object(clazz);
+    }
+
+    ~NativePeerTest() {
+        pop_local_frame();
+    }
+
+    jclass clazz;
+    jfieldID field;
+    jobject obj;
+    std::atomic<int> destroyed{0};
+};
+
+TEST_F(NativePeerTest, finds_peer_by_handle) {
+    jlong handle = new_native_peer(std::make_unique<counted_peer>(&destroyed, 7));
+    EXPECT_NE(handle, 0);
+    EXPECT_EQ(get_native_peer<counted_peer>(handle)->value, 7);
+
+    EXPECT_TRUE(erase_native_peer(handle));
+    EXPECT_EQ(destroyed.load(), 1);
+}
+
+TEST_F(NativePeerTest, zero_handle_has_no_peer) {
+    EXPECT_EQ(get_native_peer<counted_peer>(0), nullptr);
+    EXPECT_FALSE(erase_native_peer(0));
+}
+
+TEST_F(NativePeerTest, does_not_find_peer_of_other_type) {
+    jlong handle = new_native_peer(std::make_unique<counted_peer>(&destroyed, 7));
+    EXPECT_EQ(get_native_peer<other_peer>(handle), nullptr);
+    erase_native_peer(handle);
+}
+
+TEST_F(NativePeerTest, stale_handle_does_not_find_peer_reusing_slot) {
+    size_t num_peers = get_num_native_peers();
+    jlong stale = new_native_peer(std::make_unique<counted_peer>(&destroyed, 1));
+    EXPECT_TRUE(erase_native_peer(stale));
+    EXPECT_FALSE(erase_native_peer(stale));
+    EXPECT_EQ(destroyed.load(), 1);
+
+    jlong handle = new_native_peer(std::make_unique<counted_peer>(&destroyed, 2));
+    EXPECT_NE(handle, stale);
+    EXPECT_EQ(uint32_t(handle), uint32_t(stale));  // same slot
+    EXPECT_EQ(get_native_peer<counted_peer>(stale), nullptr);
+    EXPECT_EQ(get_native_peer<counted_peer>(handle)->value, 2);
+    EXPECT_EQ(get_num_native_peers(), num_peers + 1);
+
+    erase_native_peer(handle);
+    EXPECT_EQ(get_num_native_peers(), num_peers);
+}
+
+TEST_F(NativePeerTest, attaches_peer_to_object) {
+    auto peer = attach_native_peer(obj, field, std::make_unique<counted_peer>(&destroyed, 7));
+    EXPECT_NE(get_field<jlong>(obj, field), 0);
+    EXPECT_EQ(get_native_peer<counted_peer>(obj, field), peer);
+
+    destroy_native_peer(obj, field);
+    EXPECT_EQ(get_field<jlong>(obj, field), 0);
+    EXPECT_EQ(get_native_peer<counted_peer>(obj, field), nullptr);
+    EXPECT_EQ(destroyed.load(), 1);
+
+    destroy_native_peer(obj, field);
+    EXPECT_EQ(destroyed.load(), 1);
+}
+
+TEST_F(NativePeerTest, attaching_destroys_previous_peer) {
+    attach_native_peer(obj, field, std::make_unique<counted_peer>(&destroyed, 1));
+    attach_native_peer(obj, field, std::make_unique<counted_peer>(&destroyed, 2));
+    EXPECT_EQ(destroyed.load(), 1);
+    EXPECT_EQ(get_native_peer<counted_peer>(obj, field)->value, 2);
+
+    destroy_native_peer(obj, field);
+    EXPECT_EQ(destroyed.load(), 2);
+}
+
+TEST_F(NativePeerTest, cleaner_destroys_peer_of_unreachable_object) {
+    push_local_frame(16);
+    attach_native_peer(alloc_object(clazz), field, std::make_unique<counted_peer>(&destroyed, 7));
+    pop_local_frame();
+
+    jclass system_class = find_class("java/lang/System");
+    jmethodID gc_method = get_static_method_id(system_class, "gc", "()V");
+    for (int i = 0; i < 1000 && destroyed == 0; ++i) {
+        call_static_method<void>(system_class, gc_method);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(destroyed.load(), 1);
+}
+
+}  // namespace whatjni
@@ -3,7 +3,10 @@
 #include "gtest/gtest.h"
 
 #include <algorithm>
+#include <memory>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 /*
 std::string to_std_string() {
@@ -251,6 +254,92 @@ TEST_F(RefTest, can_use_ref_as_key_in_unordered_collection_with_default_value_eq
     ASSERT_EQ(map[ref2], 2);
     ASSERT_EQ(map[ref3], 3);
 }
+
+TEST_F(RefTest, local_ref_is_local_wherever_it_resides) {
+    auto ref1 = std::make_unique<local_ref<Point>>(obj1);
+    EXPECT_EQ(get_object_ref_type((jobject) ref1->operator->()), JNILocalRefType);
+    EXPECT_TRUE(*ref1 == ref<Point>(obj1));
+}
+
+TEST_F(RefTest, global_ref_is_global_wherever_it_resides) {
+    global_ref<Point> ref1(obj1);
+    EXPECT_EQ(get_object_ref_type((jobject) ref1.operator->()), JNIGlobalRefType);
+    EXPECT_TRUE(ref1 == ref<Point>(obj1));
+}
+
+TEST_F(RefTest, can_move_construct_global_refs) {
+    global_ref<Point> ref1(obj1);
+    global_ref<Point> ref2(std::move(ref1));
+    EXPECT_TRUE(ref2);
+    EXPECT_FALSE(ref1);
+}
+
+TEST_F(RefTest, can_move_assign_local_refs) {
+    local_ref<Point> ref1(obj1);
+    local_ref<Point> ref2;
+    ref2 = std::move(ref1);
+    EXPECT_TRUE(ref2);
+    EXPECT_FALSE(ref1);
+}
+
+TEST_F(RefTest, can_convert_between_ref_kinds) {
+    ref<Point> ref1(obj1);
+    global_ref<Point> ref2(ref1);
+    local_ref<Point> ref3(ref2);
+    ref<Point> ref4(std::move(ref2));
+    EXPECT_EQ(get_object_ref_type((jobject) ref3.operator->()), JNILocalRefType);
+    EXPECT_EQ(get_object_ref_type((jobject) ref4.operator->()), JNILocalRefType);
+    EXPECT_TRUE(ref1 == ref3);
+    EXPECT_TRUE(ref1 == ref4);
+}
+
+TEST_F(RefTest, global_ref_binds_to_ref_parameter) {
+    global_ref<Point> ref1(obj1);
+    auto get = [](const ref<Point>& r) { return r.operator->(); };
+    EXPECT_EQ(get(ref1), ref1.operator->());
+}
+
+TEST_F(RefTest, local_and_global_refs_do_not_bind_to_mutable_ref) {
+    // Assigning through a ref<T>& would choose the kind of ref by where the object resides.
+    static_assert(!std::is_convertible_v<local_ref<Point>&, ref<Point>&>);
+    static_assert(!std::is_convertible_v<global_ref<Point>&, ref<Point>&>);
+    static_assert(std::is_convertible_v<global_ref<Point>&, const ref<Point>&>);
+
+    global_ref<Point> ref1(obj1);
+    ref<java::lang::Object> ref2(ref1);
+    EXPECT_TRUE(ref2 == ref1);
+    EXPECT_TRUE(ref1 == ref2);
+    EXPECT_FALSE(ref1 == nullptr);
+}
+
+TEST_F(RefTest, can_use_global_ref_as_key_in_unordered_collection) {
+    global_ref<Point> ref1(obj1);
+    global_ref<Point> ref2(obj2);
+
+    std::unordered_map<global_ref<Point>, int> map;
+    map[ref1] = 1;
+    map[ref2] = 2;
+
+    ASSERT_EQ(map[ref1], 1);
+    ASSERT_EQ(map[ref2], 2);
+}
+
+TEST_F(RefTest, string_literal_is_created_once_per_call_site) {
+    std::vector<jobject> objs;
+    for (int i = 0; i < 2; ++i) {
+        const ref<java::lang::String>& str = WHATJNI_LITERAL("hello");
+        EXPECT_EQ(get_object_ref_type((jobject) str.operator->()), JNIGlobalRefType);
+        objs.push_back((jobject) str.operator->());
+    }
+    EXPECT_EQ(objs[0], objs[1]);
+    EXPECT_EQ(to_std_string(WHATJNI_LITERAL("hello")), "hello");
+}
+
+TEST_F(RefTest, interned_string_literals_are_same_object) {
+    EXPECT_TRUE(WHATJNI_INTERNED("hello") == WHATJNI_INTERNED("hello"));
+    EXPECT_FALSE(WHATJNI_LITERAL("hello") == WHATJNI_LITERAL("hello"));
+}
+
 /*
 TEST_F(RefTest, c_string_to_object_ref) {
     ref<java::lang::String> str("hello");
@@ -0,0 +1,103 @@
+#include "whatjni/shared_ref.h"
+
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace whatjni {
+
+namespace {
+
+// As for ref<T>, T may be an incomplete type.
+struct Point;
+
+}  // namespace anonymous
+
+struct SharedRefTest: testing::Test {
+    SharedRefTest() {
+        push_local_frame(16);
+        clazz = find_class("java/awt/Point");
+        obj1 = (Point*) alloc_object(clazz);
+        obj2 = (Point*) alloc_object(clazz);
+    }
+
+    ~SharedRefTest() {
+        pop_local_frame();
+    }
+
+    jclass clazz;
+    ref<Point> obj1;
+    ref<Point> obj2;
+};
+
+TEST_F(SharedRefTest, defaults_to_null) {
+    shared_ref<Point> ref;
+    EXPECT_FALSE(ref);
+    EXPECT_EQ(ref, nullptr);
+    EXPECT_EQ(ref.use_count(), 0);
+}
+
+TEST_F(SharedRefTest, holds_one_global_ref) {
+    shared_ref<Point> ref1(obj1);
+    EXPECT_EQ(get_object_ref_type((jobject) ref1.operator->()), JNIGlobalRefType);
+    EXPECT_EQ(ref1.get(), obj1);
+}
+
+TEST_F(SharedRefTest, copies_share_global_ref) {
+    shared_ref<Point> ref1(obj1);
+    shared_ref<Point> ref2(ref1);
+    EXPECT_EQ(ref1.operator->(), ref2.operator->());
+    EXPECT_EQ(ref1.use_count(), 2);
+
+    ref2 = nullptr;
+    EXPECT_EQ(ref1.use_count(), 1);
+}
+
+TEST_F(SharedRefTest, move_leaves_source_null) {
+    shared_ref<Point> ref1(obj1);
+    shared_ref<Point> ref2(std::move(ref1));
+    EXPECT_FALSE(ref1);
+    EXPECT_EQ(ref2.get(), obj1);
+    EXPECT_EQ(ref2.use_count(), 1);
+}
+
+TEST_F(SharedRefTest, converts_to_shared_ref_of_superclass) {
+    shared_ref<Point> ref1(obj1);
+    shared_ref<java::lang::Object> ref2(ref1);
+    EXPECT_EQ(ref2.get(), obj1);
+    EXPECT_EQ(ref1, ref2);
+    EXPECT_EQ(ref1.use_count(), 1);
+
+    ref2 = std::move(ref1);
+    EXPECT_FALSE(ref1);
+    EXPECT_EQ(ref2.get(), obj1);
+}
+
+TEST_F(SharedRefTest, compares_by_identity) {
+    shared_ref<Point> ref1(obj1);
+    shared_ref<Point> ref2(obj1);
+    shared_ref<Point> ref3(obj2);
+    EXPECT_EQ(ref1, ref2);
+    EXPECT_NE(ref1, ref3);
+
+    std::unordered_set<shared_ref<Point>> set = { ref1, ref2, ref3 };
+    EXPECT_EQ(set.size(), 2);
+}
+
+TEST_F(SharedRefTest, copies_on_other_threads) {
+    shared_ref<Point> ref1(obj1);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([ref1] {
+            std::vector<shared_ref<Point>> copies(1000, ref1);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(ref1.use_count(), 1);
+}
+
+}  // namespace whatjni
@@ -0,0 +1,88 @@
+#define WHATJNI_TRACE
+#include "whatjni/trace.h"
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+#include <thread>
+
+namespace whatjni {
+
+struct TraceTest: testing::Test {
+    TraceTest() {
+        push_local_frame(16);
+        point_class = find_class("java/awt/Point");
+        point = new_object(point_class, get_method_id(point_class, "<init>", "(II)V"), jint(1), jint(2));
+        translate_method = get_method_id(point_class, "translate", "(II)V");
+        clear_trace();
+    }
+
+    ~TraceTest() {
+        stop_tracing();
+        clear_trace();
+        pop_local_frame();
+    }
+
+    // Like a generated binding.
+    void translate(jint dx, jint dy) {
+        WHATJNI_TRACE_CALL(TRACE_CALL_METHOD, "java/awt/Point", "translate", "(II)V");
+        call_method<void>(point, translate_method, dx, dy);
+    }
+
+    std::string get_trace() {
+        std::ostringstream out;
+        write_chrome_trace(out);
+        return out.str();
+    }
+
+    jclass point_class;
+    jobject point;
+    jmethodID translate_method;
+};
+
+TEST_F(TraceTest, records_nothing_until_started) {
+    translate(1, 1);
+    EXPECT_EQ(get_trace().find("translate"), std::string::npos);
+}
+
+TEST_F(TraceTest, writes_complete_event_named_by_java_method) {
+    start_tracing();
+    translate(1, 1);
+    stop_tracing();
+
+    std::string trace = get_trace();
+    EXPECT_NE(trace.find("\"name\":\"java/awt/Point.translate\""), std::string::npos);
+    EXPECT_NE(trace.find("\"cat\":\"call_method\""), std::string::npos);
+    EXPECT_NE(trace.find("\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(trace.find("\"descriptor\":\"(II)V\""), std::string::npos);
+}
+
+TEST_F(TraceTest, ring_buffer_keeps_most_recent_events) {
+    start_tracing(4);
+    point = new_global_ref(point);
+    std::thread thread([&] {
+        for (int i = 0; i < 10; ++i) {
+            translate(1, 1);
+        }
+    });
+    thread.join();
+    stop_tracing();
+    delete_global_ref(point);
+
+    std::string trace = get_trace();
+    std::string name = "java/awt/Point.translate";
+    size_t count = 0;
+    for (size_t pos = trace.find(name); pos != std::string::npos; pos = trace.find(name, pos + 1)) {
+        ++count;
+    }
+    EXPECT_EQ(count, 4u);
+}
+
+TEST_F(TraceTest, clear_trace_discards_events) {
+    start_tracing();
+    translate(1, 1);
+    clear_trace();
+    EXPECT_EQ(get_trace().find("translate"), std::string::npos);
+}
+
+}  // namespace whatjni
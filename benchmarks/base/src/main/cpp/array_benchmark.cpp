@@ -0,0 +1,69 @@
+#include "benchmark/benchmark.h"
+#include "whatjni/array.h"
+
+#include <vector>
+
+namespace whatjni {
+
+namespace {
+
+// Summing an int[] element by element, each element a JNI call, against mapping it once or copying it in bulk.
+void BM_array_get_data(benchmark::State& state) {
+    auto arr = new_array<jint>(jsize(state.range(0)));
+    for (auto _ : state) {
+        jint sum = 0;
+        for (jsize i = 0; i < state.range(0); ++i) {
+            sum += arr->get_data(i);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_array_get_data)->Range(8, 65536);
+
+void BM_array_map(benchmark::State& state) {
+    auto arr = new_array<jint>(jsize(state.range(0)));
+    for (auto _ : state) {
+        jint sum = 0;
+        auto mapped = arr->map_read_only();
+        for (jsize i = 0; i < state.range(0); ++i) {
+            sum += mapped[i];
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_array_map)->Range(8, 65536);
+
+void BM_array_map_critical(benchmark::State& state) {
+    auto arr = new_array<jint>(jsize(state.range(0)));
+    for (auto _ : state) {
+        jint sum = 0;
+        auto mapped = arr->map_critical_read_only();
+        for (jsize i = 0; i < state.range(0); ++i) {
+            sum += mapped[i];
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_array_map_critical)->Range(8, 65536);
+
+void BM_array_read_region(benchmark::State& state) {
+    auto arr = new_array<jint>(jsize(state.range(0)));
+    std::vector<jint> buffer(size_t(state.range(0)));
+    for (auto _ : state) {
+        arr->read_region(0, jsize(buffer.size()), buffer.data());
+        jint sum = 0;
+        for (jint value : buffer) {
+            sum += value;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_array_read_region)->Range(8, 65536);
+
+}  // namespace anonymous
+
+}  // namespace whatjni
@@ -0,0 +1,168 @@
+#include "benchmark/benchmark.h"
+#include "whatjni/base.h"
+#include "whatjni/batch.h"
+
+namespace whatjni {
+
+namespace {
+
+struct CallBenchmark {
+    jclass point_class = class_cache::get("java/awt/Point");
+    jclass byte_class = class_cache::get("java/lang/Byte");
+    jclass short_class = class_cache::get("java/lang/Short");
+    jclass character_class = class_cache::get("java/lang/Character");
+    jclass long_class = class_cache::get("java/lang/Long");
+    jclass float_class = class_cache::get("java/lang/Float");
+    jclass math_class = class_cache::get("java/lang/Math");
+    jobject point;
+    jobject boxed_byte;
+    jobject boxed_short;
+    jobject boxed_char;
+    jobject boxed_long;
+    jobject boxed_float;
+
+    CallBenchmark() {
+        point = new_object(point_class, get_method_id(point_class, "<init>", "(II)V"), jint(1), jint(2));
+        boxed_byte = new_object(byte_class, get_method_id(byte_class, "<init>", "(B)V"), jbyte(3));
+        boxed_short = new_object(short_class, get_method_id(short_class, "<init>", "(S)V"), jshort(3));
+        boxed_char = new_object(character_class, get_method_id(character_class, "<init>", "(C)V"), jchar('3'));
+        boxed_long = new_object(long_class, get_method_id(long_class, "<init>", "(J)V"), jlong(3));
+        boxed_float = new_object(float_class, get_method_id(float_class, "<init>", "(F)V"), jfloat(3));
+    }
+
+    ~CallBenchmark() {
+        delete_local_ref(boxed_float);
+        delete_local_ref(boxed_long);
+        delete_local_ref(boxed_char);
+        delete_local_ref(boxed_short);
+        delete_local_ref(boxed_byte);
+        delete_local_ref(point);
+    }
+};
+
+// One benchmark per return type, each calling a trivial method, so the differences are in the wrappers and the JNI
+// function table rather than in Java.
+void BM_call_method_void(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.point_class, "setLocation", "(II)V");
+    for (auto _ : state) {
+        call_method<void>(b.point, method, jint(1), jint(2));
+    }
+}
+BENCHMARK(BM_call_method_void);
+
+// BM_call_method_void with the calls recorded by a batch and replayed in Java batch::capacity at a time.
+void BM_call_method_void_batched(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.point_class, "setLocation", "(II)V");
+    batch calls;
+    for (auto _ : state) {
+        call_method<void>(b.point, method, jint(1), jint(2));
+    }
+}
+BENCHMARK(BM_call_method_void_batched);
+
+void BM_call_method_boolean(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.point_class, "equals", "(Ljava/lang/Object;)Z");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(call_method<jboolean>(b.point, method, b.point));
+    }
+}
+BENCHMARK(BM_call_method_boolean);
+
+void BM_call_method_byte(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.byte_class, "byteValue", "()B");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(call_method<jbyte>(b.boxed_byte, method));
+    }
+}
+BENCHMARK(BM_call_method_byte);
+
+void BM_call_method_short(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.short_class, "shortValue", "()S");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(call_method<jshort>(b.boxed_short, method));
+    }
+}
+BENCHMARK(BM_call_method_short);
+
+void BM_call_method_char(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.character_class, "charValue", "()C");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(call_method<jchar>(b.boxed_char, method));
+    }
+}
+BENCHMARK(BM_call_method_char);
+
+void BM_call_method_int(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.point_class, "hashCode", "()I");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(call_method<jint>(b.point, method));
+    }
+}
+BENCHMARK(BM_call_method_int);
+
+void BM_call_method_long(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.long_class, "longValue", "()J");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(call_method<jlong>(b.boxed_long, method));
+    }
+}
+BENCHMARK(BM_call_method_long);
+
+void BM_call_method_float(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.float_class, "floatValue", "()F");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(call_method<jfloat>(b.boxed_float, method));
+    }
+}
+BENCHMARK(BM_call_method_float);
+
+void BM_call_method_double(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.point_class, "getX", "()D");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(call_method<jdouble>(b.point, method));
+    }
+}
+BENCHMARK(BM_call_method_double);
+
+void BM_call_method_object(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_method_id(b.point_class, "getLocation", "()Ljava/awt/Point;");
+    for (auto _ : state) {
+        jobject result = call_method<jobject>(b.point, method);
+        benchmark::DoNotOptimize(result);
+        delete_local_ref(result);
+    }
+}
+BENCHMARK(BM_call_method_object);
+
+void BM_call_static_method_int(benchmark::State& state) {
+    CallBenchmark b;
+    jmethodID method = get_static_method_id(b.math_class, "abs", "(I)I");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(call_static_method<jint>(b.math_class, method, jint(-1)));
+    }
+}
+BENCHMARK(BM_call_static_method_int);
+
+void BM_get_field_int(benchmark::State& state) {
+    CallBenchmark b;
+    jfieldID field = get_field_id(b.point_class, "x", "I");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(get_field<jint>(b.point, field));
+    }
+}
+BENCHMARK(BM_get_field_int);
+
+}  // namespace anonymous
+
+}  // namespace whatjni
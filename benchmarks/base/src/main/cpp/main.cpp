@@ -0,0 +1,32 @@
+#include "benchmark/benchmark.h"
+#include "whatjni/base.h"
+
+#include <iostream>
+
+using namespace whatjni;
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    initialize_vm(vm_config(JNI_VERSION_1_8));
+
+    // So results from builds with and without -PwhatjniInline can be told apart.
+#ifdef WHATJNI_INLINE
+    benchmark::AddCustomContext("whatjni_inline", "true");
+#else
+    benchmark::AddCustomContext("whatjni_inline", "false");
+#endif
+
+    try {
+        benchmark::RunSpecifiedBenchmarks();
+    } catch (const jvm_exception& e) {
+        // The exception is no longer pending, so print_exception() would print nothing.
+        std::cerr << "Java exception: " << e.get_message() << std::endl;
+        return 1;
+    }
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "benchmark/benchmark.h"
+#include "whatjni/ref.h"
+#include "whatjni/weak_ref.h"
+
+#include <memory>
+
+namespace whatjni {
+
+namespace {
+
+struct Point;
+
+ref<Point> new_point() {
+    return ref<Point>(alloc_object(class_cache::get("java/awt/Point")), own_ref);
+}
+
+// A ref on the stack holds a LocalRef and one on the heap a GlobalRef, so copying either creates a JNI ref while moving
+// either does not, except moving between stack and heap.
+void BM_ref_copy_stack(benchmark::State& state) {
+    ref<Point> point = new_point();
+    for (auto _ : state) {
+        ref<Point> copy(point);
+        benchmark::DoNotOptimize(copy);
+    }
+}
+BENCHMARK(BM_ref_copy_stack);
+
+void BM_ref_move_stack(benchmark::State& state) {
+    ref<Point> point = new_point();
+    for (auto _ : state) {
+        ref<Point> moved(std::move(point));
+        point = std::move(moved);
+        benchmark::DoNotOptimize(point);
+    }
+}
+BENCHMARK(BM_ref_move_stack);
+
+void BM_ref_copy_heap(benchmark::State& state) {
+    auto point = std::make_unique<ref<Point>>(new_point());
+    auto copy = std::make_unique<ref<Point>>();
+    for (auto _ : state) {
+        *copy = *point;
+        benchmark::DoNotOptimize(*copy);
+    }
+}
+BENCHMARK(BM_ref_copy_heap);
+
+void BM_ref_move_heap(benchmark::State& state) {
+    auto point = std::make_unique<ref<Point>>(new_point());
+    auto moved = std::make_unique<ref<Point>>();
+    for (auto _ : state) {
+        *moved = std::move(*point);
+        *point = std::move(*moved);
+        benchmark::DoNotOptimize(*point);
+    }
+}
+BENCHMARK(BM_ref_move_heap);
+
+void BM_new_and_delete_auto_ref_stack(benchmark::State& state) {
+    ref<Point> point = new_point();
+    for (auto _ : state) {
+        jobject obj;
+        new_auto_ref(&obj, (jobject) point.operator->());
+        benchmark::DoNotOptimize(obj);
+        delete_auto_ref(&obj);
+    }
+}
+BENCHMARK(BM_new_and_delete_auto_ref_stack);
+
+void BM_new_and_delete_auto_ref_heap(benchmark::State& state) {
+    ref<Point> point = new_point();
+    auto obj = std::make_unique<jobject>();
+    for (auto _ : state) {
+        new_auto_ref(obj.get(), (jobject) point.operator->());
+        benchmark::DoNotOptimize(*obj);
+        delete_auto_ref(obj.get());
+    }
+}
+BENCHMARK(BM_new_and_delete_auto_ref_heap);
+
+void BM_weak_ref_lock(benchmark::State& state) {
+    ref<Point> point = new_point();
+    weak_ref<Point> weak(point);
+    for (auto _ : state) {
+        ref<Point> locked = weak.lock();
+        benchmark::DoNotOptimize(locked);
+    }
+}
+BENCHMARK(BM_weak_ref_lock);
+
+void BM_find_class(benchmark::State& state) {
+    for (auto _ : state) {
+        jclass clazz = find_class("java/awt/Point");
+        benchmark::DoNotOptimize(clazz);
+        delete_local_ref(clazz);
+    }
+}
+BENCHMARK(BM_find_class);
+
+void BM_class_cache_get(benchmark::State& state) {
+    for (auto _ : state) {
+        jclass clazz = class_cache::get("java/awt/Point");
+        benchmark::DoNotOptimize(clazz);
+    }
+}
+BENCHMARK(BM_class_cache_get);
+
+}  // namespace anonymous
+
+}  // namespace whatjni
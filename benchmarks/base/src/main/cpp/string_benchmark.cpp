@@ -0,0 +1,46 @@
+#include "benchmark/benchmark.h"
+#include "whatjni/base.h"
+
+#include <string>
+
+namespace whatjni {
+
+namespace {
+
+// ASCII strings take the fast path; any other character sends the whole string down the slow path, which converts it
+// to modified UTF-8.
+std::string make_string(size_t length, bool ascii) {
+    std::string result;
+    while (result.size() < length) {
+        result += ascii ? "a" : "\xC3\xA9";  // U+00E9
+    }
+    return result;
+}
+
+void BM_new_utf8_string(benchmark::State& state, bool ascii) {
+    std::string str = make_string(size_t(state.range(0)), ascii);
+    for (auto _ : state) {
+        jstring result = new_utf8_string(str.c_str(), jsize(str.size()));
+        benchmark::DoNotOptimize(result);
+        delete_local_ref(result);
+    }
+    state.SetBytesProcessed(state.iterations() * int64_t(str.size()));
+}
+BENCHMARK_CAPTURE(BM_new_utf8_string, fast_path, true)->Range(8, 4096);
+BENCHMARK_CAPTURE(BM_new_utf8_string, slow_path, false)->Range(8, 4096);
+
+void BM_to_std_string(benchmark::State& state, bool ascii) {
+    std::string str = make_string(size_t(state.range(0)), ascii);
+    jstring jstr = new_utf8_string(str.c_str(), jsize(str.size()));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(to_std_string(jstr));
+    }
+    delete_local_ref(jstr);
+    state.SetBytesProcessed(state.iterations() * int64_t(str.size()));
+}
+BENCHMARK_CAPTURE(BM_to_std_string, ascii, true)->Range(8, 4096);
+BENCHMARK_CAPTURE(BM_to_std_string, non_ascii, false)->Range(8, 4096);
+
+}  // namespace anonymous
+
+}  // namespace whatjni
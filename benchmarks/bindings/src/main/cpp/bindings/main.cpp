@@ -0,0 +1,352 @@
+#include "java/io/BufferedReader.class.h"
+#include "java/io/StringReader.class.h"
+#include "java/lang/Double.class.h"
+#include "java/lang/String.class.h"
+#include "org/apache/commons/math3/stat/descriptive/SummaryStatistics.class.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using java::io::BufferedReader;
+using java::io::StringReader;
+using java::lang::Double;
+using java::lang::String;
+using org::apache::commons::math3::stat::descriptive::SummaryStatistics;
+
+using namespace whatjni;
+
+// Drives the calls made by samples/statistics at scale, through the generated bindings and through the JNIEnv function
+// table directly, to measure what the generated layers cost over the JNI floor. Each thread makes the given number of
+// calls on objects of its own, so threads contend only inside the JVM.
+namespace {
+
+// Calls are timed in blocks, each sample being a block's mean, since reading the clock around a single call would cost
+// about as much as the call.
+const size_t BLOCK_SIZE = 64;
+const size_t NUM_STRINGS = 1024;
+const size_t NUM_LINES = 65536;
+
+enum mode {
+    GENERATED,
+    RAW_JNI,
+};
+
+const char* get_mode_name(mode m) {
+    return m == GENERATED ? "generated" : "raw_jni";
+}
+
+struct thread_result {
+    std::vector<uint64_t> samples;  // nanoseconds per call
+    std::string error;
+};
+
+struct result {
+    std::string workload;
+    mode m;
+    size_t threads;
+    uint64_t calls;
+    double seconds;
+    uint64_t p50_nanos;
+    uint64_t p99_nanos;
+    std::string error;
+};
+
+uint64_t now_nanos() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+template <typename Call>
+void run_calls(size_t count, thread_result* result, Call&& call) {
+    result->samples.reserve(count / BLOCK_SIZE + 1);
+    for (size_t i = 0; i < count;) {
+        size_t end = std::min(i + BLOCK_SIZE, count);
+        size_t n = end - i;
+        uint64_t start = now_nanos();
+        for (; i < end; ++i) {
+            call(i);
+        }
+        result->samples.push_back((now_nanos() - start) / n);
+    }
+}
+
+// The raw JNI path still checks for exceptions after every call, as any correct JNI code must.
+void check(JNIEnv* env) {
+    if (env->ExceptionCheck()) {
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+        throw std::runtime_error("Java exception");
+    }
+}
+
+std::atomic<double> g_sink;
+
+void add_value(mode m, size_t count, thread_result* result) {
+    auto statistics = SummaryStatistics::new_object();
+    std::vector<jdouble> values(4096);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = double(i % 97) * 0.5;
+    }
+
+    if (m == GENERATED) {
+        run_calls(count, result, [&](size_t i) {
+            statistics->addValue(values[i % values.size()]);
+        });
+    } else {
+        JNIEnv* env = attach_current_thread();
+        jobject obj = (jobject) statistics.operator->();
+        jmethodID method = get_method_id(
+            class_cache::get("org/apache/commons/math3/stat/descriptive/SummaryStatistics"), "addValue", "(D)V");
+        run_calls(count, result, [&](size_t i) {
+            env->CallVoidMethod(obj, method, values[i % values.size()]);
+            check(env);
+        });
+    }
+
+    g_sink.store(statistics->getMean(), std::memory_order_relaxed);
+}
+
+void parse_double(mode m, size_t count, thread_result* result) {
+    std::vector<ref<String>> strings;  // on the heap, so global refs
+    for (size_t i = 0; i < NUM_STRINGS; ++i) {
+        strings.push_back(ref<String>(std::to_string(double(i) * 1.25)));
+    }
+
+    jdouble sum = 0;
+    if (m == GENERATED) {
+        run_calls(count, result, [&](size_t i) {
+            sum += Double::parseDouble(strings[i % NUM_STRINGS]);
+        });
+    } else {
+        JNIEnv* env = attach_current_thread();
+        jclass clazz = class_cache::get("java/lang/Double");
+        jmethodID method = get_static_method_id(clazz, "parseDouble", "(Ljava/lang/String;)D");
+        run_calls(count, result, [&](size_t i) {
+            sum += env->CallStaticDoubleMethod(clazz, method, (jobject) strings[i % NUM_STRINGS].operator->());
+            check(env);
+        });
+    }
+
+    g_sink.store(sum, std::memory_order_relaxed);
+}
+
+void read_line(mode m, size_t count, thread_result* result) {
+    std::string text;
+    for (size_t i = 0; i < NUM_LINES; ++i) {
+        text += std::to_string(double(i) * 0.25) + "\n";
+    }
+    ref<String> lines(text);
+
+    // Starts again from the first line at the end of the text.
+    ref<BufferedReader> reader;
+    auto reset = [&] {
+        reader = BufferedReader::new_object(StringReader::new_object(lines));
+    };
+    reset();
+
+    if (m == GENERATED) {
+        run_calls(count, result, [&](size_t) {
+            auto line = reader->readLine();
+            if (line == nullptr) {
+                reset();
+            }
+        });
+    } else {
+        JNIEnv* env = attach_current_thread();
+        jmethodID method = get_method_id(class_cache::get("java/io/BufferedReader"), "readLine",
+                                         "()Ljava/lang/String;");
+        run_calls(count, result, [&](size_t) {
+            jobject line = env->CallObjectMethod((jobject) reader.operator->(), method);
+            check(env);
+            if (line) {
+                env->DeleteLocalRef(line);
+            } else {
+                reset();
+            }
+        });
+    }
+}
+
+struct workload {
+    const char* name;
+    void (*run)(mode m, size_t count, thread_result* result);
+};
+
+const workload WORKLOADS[] = {
+    { "SummaryStatistics.addValue", add_value },
+    { "Double.parseDouble", parse_double },
+    { "BufferedReader.readLine", read_line },
+};
+
+uint64_t get_percentile(const std::vector<uint64_t>& sorted, double percentile) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, size_t(sorted.size() * percentile / 100));
+    return sorted[index];
+}
+
+result run_workload(const workload& w, mode m, size_t num_threads, size_t count) {
+    std::vector<thread_result> thread_results(num_threads);
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::atomic<uint64_t> end_nanos{0};
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&, i] {
+            attach_options options;
+            options.daemon = true;
+            options.name = "whatjni-benchmark-" + std::to_string(i);
+            scoped_attach attach(options);
+
+            thread_result* r = &thread_results[i];
+            ready.fetch_add(1);
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+
+            try {
+                w.run(m, count, r);
+            } catch (const jvm_exception& e) {
+                r->error = e.get_message();
+            } catch (const std::exception& e) {
+                r->error = e.what();
+            }
+
+            uint64_t end = now_nanos();
+            uint64_t previous = end_nanos.load();
+            while (end > previous && !end_nanos.compare_exchange_weak(previous, end)) {
+            }
+        });
+    }
+
+    while (ready.load() < num_threads) {
+        std::this_thread::yield();
+    }
+    uint64_t start = now_nanos();
+    go.store(true);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Includes each thread's setup, which is small next to millions of calls.
+    result res = { w.name, m, num_threads, uint64_t(count) * num_threads, (end_nanos.load() - start) / 1e9, 0, 0, "" };
+
+    std::vector<uint64_t> samples;
+    for (auto& r : thread_results) {
+        samples.insert(samples.end(), r.samples.begin(), r.samples.end());
+        if (!r.error.empty()) {
+            res.error = r.error;
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+    res.p50_nanos = get_percentile(samples, 50);
+    res.p99_nanos = get_percentile(samples, 99);
+    return res;
+}
+
+std::vector<size_t> parse_thread_counts(const char* arg) {
+    std::vector<size_t> counts;
+    std::istringstream stream(arg);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        counts.push_back(std::max<size_t>(1, std::strtoul(item.c_str(), nullptr, 10)));
+    }
+    return counts;
+}
+
+void write_json(std::ostream& out, const std::vector<result>& results) {
+    out << "{\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const result& r = results[i];
+        out << (i ? ",\n" : "\n");
+        out << "{\"workload\":\"" << r.workload << "\",\"mode\":\"" << get_mode_name(r.m) << "\",\"threads\":"
+            << r.threads << ",\"calls\":" << r.calls << ",\"seconds\":" << r.seconds << ",\"calls_per_second\":"
+            << r.calls / r.seconds << ",\"p50_nanos\":" << r.p50_nanos << ",\"p99_nanos\":" << r.p99_nanos;
+        if (!r.error.empty()) {
+            out << ",\"error\":true";
+        }
+        out << "}";
+    }
+    out << "\n]}\n";
+}
+
+}  // namespace anonymous
+
+int main(int argc, const char** argv) {
+    size_t count = 2000000;
+    std::vector<size_t> thread_counts = { 1, 2, 4, 8 };
+    const char* json_path = nullptr;
+    const char* only = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--values") && i + 1 < argc) {
+            count = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            thread_counts = parse_thread_counts(argv[++i]);
+        } else if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (!strcmp(argv[i], "--workload") && i + 1 < argc) {
+            only = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--values <calls per thread>] [--threads <n,n,...>] [--workload <name>] [--json <file>]\n";
+            return 1;
+        }
+    }
+
+    initialize_vm(vm_config(JNI_VERSION_1_8));
+
+    std::cout << std::left << std::setw(28) << "workload" << std::setw(11) << "mode" << std::right << std::setw(8)
+              << "threads" << std::setw(14) << "calls/s" << std::setw(10) << "p50 ns" << std::setw(10) << "p99 ns"
+              << std::setw(12) << "vs raw JNI" << "\n";
+
+    std::vector<result> results;
+    for (const workload& w : WORKLOADS) {
+        if (only && strcmp(only, w.name)) {
+            continue;
+        }
+
+        for (size_t num_threads : thread_counts) {
+            // Raw JNI first, so the generated result can be compared with it.
+            double raw_rate = 0;
+            for (mode m : { RAW_JNI, GENERATED }) {
+                result r = run_workload(w, m, num_threads, count);
+                double rate = r.calls / r.seconds;
+                if (m == RAW_JNI) {
+                    raw_rate = rate;
+                }
+
+                std::cout << std::left << std::setw(28) << r.workload << std::setw(11) << get_mode_name(m)
+                          << std::right << std::setw(8) << num_threads << std::setw(14) << std::fixed
+                          << std::setprecision(0) << rate << std::setw(10) << r.p50_nanos << std::setw(10)
+                          << r.p99_nanos << std::setw(11) << std::setprecision(1) << rate / raw_rate * 100 << "%";
+                if (!r.error.empty()) {
+                    std::cout << "  error: " << r.error;
+                }
+                std::cout << "\n";
+
+                results.push_back(std::move(r));
+            }
+        }
+    }
+
+    if (json_path) {
+        std::ofstream out(json_path);
+        write_json(out, results);
+    }
+
+    return 0;
+}
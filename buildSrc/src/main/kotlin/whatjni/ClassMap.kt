@@ -4,7 +4,7 @@ import java.io.BufferedWriter
 import java.io.File
 import java.io.FileWriter
 
-class ClassMap(val generatedDir: File, val loader: ClassLoader, val nativePackages: Set<String>) {
+class ClassMap(val generatedDir: File, val loader: ClassLoader, val nativePackages: Set<String>, val metrics: Boolean) {
     val classes = sortedMapOf<String, ClassModel>()
 
     fun get(className: String): ClassModel {
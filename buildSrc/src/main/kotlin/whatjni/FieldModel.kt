@@ -9,6 +9,7 @@ class FieldModel(val access: Int,
                  val signature: String?,
                  val value: Any?) : Comparable<FieldModel> {
     val escapedName = escapeSimpleName(unescapedName)
+    val bindingName = "field_" + escapedName
     val type = Type.getType(descriptor)
 
     override fun compareTo(other: FieldModel): Int {
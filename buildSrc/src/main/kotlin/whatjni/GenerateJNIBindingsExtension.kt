@@ -1,7 +1,11 @@
 package whatjni
 
+import org.gradle.api.provider.Property
 import org.gradle.api.provider.SetProperty
 
 interface GenerateJNIBindingsExtension {
     val nativePackages: SetProperty<String>
+
+    // Whether generated methods and field accessors count their calls and time them; see whatjni/metrics.h.
+    val metrics: Property<Boolean>
 }
\ No newline at end of file
@@ -26,6 +26,7 @@ abstract class GenerateJNIBindingsPlugin: Plugin<Project> {
 
     override fun apply(project: Project) {
         val extension = project.extensions.create("whatjni", GenerateJNIBindingsExtension::class.java)
+        extension.metrics.convention(false)
 
         val jniBinding = project.configurations.create(BINDING_CONFIGURATION).apply {
             isCanBeConsumed = false
@@ -40,6 +41,7 @@ abstract class GenerateJNIBindingsPlugin: Plugin<Project> {
             it.dependsOn(jniBinding)
             it.classpath.from(jniBinding.files)
             it.nativePackages.addAll(extension.nativePackages)
+            it.metrics.set(extension.metrics)
         }
 
         project.tasks.withType(CppCompile::class.java).configureEach {
@@ -8,6 +8,7 @@ import kotlinx.serialization.json.Json
 import org.ainslec.picocog.PicoWriter
 import org.gradle.api.DefaultTask
 import org.gradle.api.file.*
+import org.gradle.api.provider.Property
 import org.gradle.api.provider.SetProperty
 import org.gradle.api.tasks.*
 import org.gradle.work.ChangeType
@@ -45,6 +46,9 @@ abstract class GenerateJNIBindingsTask : DefaultTask() {
     @get:Input
     abstract val nativePackages: SetProperty<String>
 
+    @get:Input
+    abstract val metrics: Property<Boolean>
+
     init {
         source.from(projectLayout.projectDirectory.dir("src/main/cpp"), projectLayout.projectDirectory.dir("src/main/headers"))
         generatedDir.convention(projectLayout.buildDirectory.dir(GenerateJNIBindingsPlugin.GENERATED_DIR))
@@ -57,7 +61,7 @@ abstract class GenerateJNIBindingsTask : DefaultTask() {
         val dependencies = updateIndexDependencies(changes, index)
 
         URLClassLoader((classpath.map { it.toURI().toURL() }).toTypedArray()).use { loader ->
-            val classMap = ClassMap(generatedDir.get().asFile, loader, nativePackages.get())
+            val classMap = ClassMap(generatedDir.get().asFile, loader, nativePackages.get(), metrics.get())
             for (className in dependencies) {
                 classMap.get(className)
             }
@@ -9,6 +9,8 @@ import org.objectweb.asm.*
 import java.io.File
 import java.io.FileWriter
 
+const val NATIVE_PEER_FIELD = "nativeHandle"
+
 class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNative: Boolean): ClassVisitor(Opcodes.ASM7) {
     lateinit var classModel: ClassModel
     val writer = PicoWriter()
@@ -67,6 +69,7 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
         writeForwardDeclarations()
         val namespaceParts = classModel.nameParts.take(classModel.nameParts.size - 1)
         writeOpenNamespace(writer, namespaceParts)
+        writeBindingTable()
         writeFieldClass()
         writeMethodClass()
         writeCloseNamespace(writer, namespaceParts)
@@ -145,6 +148,39 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
         writer.writeln()
     }
 
+    // Table of the class, method and field bindings used by this class's members. It's a class template so that its static
+    // members may be defined in this header without violating the one definition rule.
+    fun writeBindingTable() {
+        val table = bindingTable()
+        val fields = classModel.fields.filter { isFieldBound(it) }
+        val methods = classModel.methods.filter { isMethodGenerated(it) }
+
+        writer.writeln("template <typename = void>")
+        writer.writeln_r("struct $table {")
+        writer.writeln("static whatjni::class_binding clazz;")
+        for (field in fields) {
+            writer.writeln("static whatjni::field_binding ${field.bindingName};")
+        }
+        for (method in methods) {
+            writer.writeln("static whatjni::method_binding ${method.bindingName};")
+        }
+        writer.writeln_l("};")
+        writer.writeln()
+
+        writer.writeln("template <typename T> whatjni::class_binding $table<T>::clazz(\"${classModel.unescapedName}\");")
+        for (field in fields) {
+            field.apply {
+                writer.writeln("template <typename T> whatjni::field_binding $table<T>::$bindingName($table<T>::clazz, \"$unescapedName\", \"$descriptor\", ${isStatic(access)});")
+            }
+        }
+        for (method in methods) {
+            method.apply {
+                writer.writeln("template <typename T> whatjni::method_binding $table<T>::$bindingName($table<T>::clazz, \"$unescapedName\", \"$descriptor\", ${isStatic(access)});")
+            }
+        }
+        writer.writeln()
+    }
+
     fun writeFieldClass() {
         val nameParts = classModel.nameParts
         writer.write("class var_${nameParts[nameParts.size - 1]}")
@@ -166,26 +202,27 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
 
     fun writeField(field: FieldModel) {
         field.apply {
-            if ((access and Opcodes.ACC_PRIVATE) != 0) {
-                if (!implementsNative || !classModel.hasNativeMethods) {
-                    return
-                }
+            if (!isVisible(access)) {
+                return
             }
 
             val cppType = makeCPPType(type, false)
             val paramCPPType = makeCPPType(type, true)
             val escapedName = escapeSimpleName(unescapedName)
             val modifiers = getModifiers(access)
+            val fieldID = "${bindingTable()}<>::$bindingName.get()"
 
-            var getFieldID = "whatjni::get_field_id"
             var getField = "whatjni::get_field"
             var setField = "whatjni::set_field"
+            var getOp = "whatjni::TRACE_GET_FIELD"
+            var setOp = "whatjni::TRACE_SET_FIELD"
             var target = "(jobject) this"
-            if ((access and Opcodes.ACC_STATIC) != 0) {
-                getFieldID = "whatjni::get_static_field_id"
+            if (isStatic(access)) {
                 getField = "whatjni::get_static_field"
                 setField = "whatjni::set_static_field"
-                target = "clazz"
+                getOp = "whatjni::TRACE_GET_STATIC_FIELD"
+                setOp = "whatjni::TRACE_SET_STATIC_FIELD"
+                target = "${bindingTable()}<>::clazz.get()"
             }
 
             writeAccess(access)
@@ -194,12 +231,10 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
                 writer.writeln("static constexpr $cppType $escapedName = ${literalValue(value)};")
             } else if (((access and Opcodes.ACC_STATIC) != 0) and ((access and Opcodes.ACC_FINAL) != 0)) {
                 writer.writeln_r("static const $cppType& get_$escapedName() {")
-                writer.writeln("static jclass clazz = whatjni::find_class(\"${classModel.unescapedName}\");")
-                writer.writeln("static jfieldID field = whatjni::get_static_field_id(clazz, \"$unescapedName\", \"$descriptor\");")
 
                 when (type.sort) {
-                    Type.OBJECT, Type.ARRAY -> writer.writeln("static whatjni::no_destroy<$cppType> value($getField<jobject>($target, field), whatjni::own_ref);")
-                    else ->                    writer.writeln("static whatjni::no_destroy<$cppType> value($getField<$cppType>($target, field));")
+                    Type.OBJECT, Type.ARRAY -> writer.writeln("static whatjni::no_destroy<$cppType> value($getField<jobject>($target, $fieldID), whatjni::own_ref);")
+                    else ->                    writer.writeln("static whatjni::no_destroy<$cppType> value($getField<$cppType>($target, $fieldID));")
                 }
 
                 writer.writeln("return value.get();")
@@ -213,24 +248,22 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
                 writer.writeln_lr("#endif")
             } else {
                 writer.writeln_r("$modifiers$cppType get_$escapedName() {")
-                writer.writeln("static jclass clazz = whatjni::find_class(\"${classModel.unescapedName}\");")
-                writer.writeln("static jfieldID field = $getFieldID(clazz, \"$unescapedName\", \"$descriptor\");")
+                writeCallSite(getOp, unescapedName, descriptor)
 
                 when (type.sort) {
-                    Type.OBJECT, Type.ARRAY -> writer.writeln("return $cppType($getField<jobject>($target, field), whatjni::own_ref);")
-                    else ->                    writer.writeln("return $getField<$cppType>($target, field);")
+                    Type.OBJECT, Type.ARRAY -> writer.writeln("return $cppType($getField<jobject>($target, $fieldID), whatjni::own_ref);")
+                    else ->                    writer.writeln("return $getField<$cppType>($target, $fieldID);")
                 }
 
                 writer.writeln_l("}")
 
                 if ((access and Opcodes.ACC_FINAL) == 0) {
                     writer.writeln_r("${modifiers}void set_$escapedName($paramCPPType value) {")
-                    writer.writeln("static jclass clazz = whatjni::find_class(\"${classModel.unescapedName}\");")
-                    writer.writeln("static jfieldID field = $getFieldID(clazz, \"$unescapedName\", \"$descriptor\");")
+                    writeCallSite(setOp, unescapedName, descriptor)
 
                     when (type.sort) {
-                        Type.OBJECT, Type.ARRAY -> writer.writeln("$setField($target, field, (jobject) value.operator->());")
-                        else ->                    writer.writeln("$setField($target, field, value);")
+                        Type.OBJECT, Type.ARRAY -> writer.writeln("$setField($target, $fieldID, (jobject) value.operator->());")
+                        else ->                    writer.writeln("$setField($target, $fieldID, value);")
                     }
 
                     writer.writeln_l("}")
@@ -249,6 +282,15 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
         }
     }
 
+    // The trace call expands to nothing unless the bindings are compiled with WHATJNI_TRACE defined.
+    fun writeCallSite(op: String, name: String, descriptor: String) {
+        val args = "$op, \"${classModel.unescapedName}\", \"$name\", \"$descriptor\""
+        writer.writeln("WHATJNI_TRACE_CALL($args);")
+        if (classMap.metrics) {
+            writer.writeln("WHATJNI_METRICS_CALL($args);")
+        }
+    }
+
     fun literalValue(value: Any?): String {
         if (value == null) {
             return "nullptr"
@@ -287,6 +329,7 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
             writeProperty(property)
         }
 
+        writeNativePeer()
         writeMethodRegistration()
 
         writer.writeln_l("};")
@@ -295,13 +338,7 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
 
     fun writeMethod(method: MethodModel) {
         method.apply {
-            if ((access and Opcodes.ACC_PRIVATE) != 0) {
-                if (!implementsNative || !classModel.hasNativeMethods) {
-                    return
-                }
-            }
-
-            if (isConstructor && (classModel.access and Opcodes.ACC_ABSTRACT) != 0) {
+            if (!isMethodGenerated(method)) {
                 return
             }
 
@@ -309,14 +346,18 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
             val cppReturnType = makeCPPType(type.returnType, false)
             val escapedName = escapeSimpleName(unescapedName)
             val modifiers = getModifiers(access)
+            val methodID = "${bindingTable()}<>::$bindingName.get()"
 
-            var getMethodID = "whatjni::get_method_id"
             var callMethod = "whatjni::call_method"
+            var op = "whatjni::TRACE_CALL_METHOD"
             var target = "(jobject) this"
-            if ((access and Opcodes.ACC_STATIC) != 0) {
-                getMethodID = "whatjni::get_static_method_id"
+            if (isStatic(access)) {
                 callMethod = "whatjni::call_static_method"
-                target = "clazz"
+                op = "whatjni::TRACE_CALL_STATIC_METHOD"
+                target = "${bindingTable()}<>::clazz.get()"
+            }
+            if (isConstructor) {
+                op = "whatjni::TRACE_NEW_OBJECT"
             }
             writeAccess(access)
 
@@ -327,17 +368,15 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
             }
             writeParameters(type)
             writer.writeln_r(" {")
-
-            writer.writeln("static jclass clazz = whatjni::find_class(\"${classModel.unescapedName}\");")
-            writer.writeln("static jmethodID method = $getMethodID(clazz, \"$unescapedName\", \"$descriptor\");")
+            writeCallSite(op, unescapedName, descriptor)
 
             writer.write("return ")
             if (isConstructor) {
-                writer.write("whatjni::ref<${classModel.escapedName}>(whatjni::new_object(clazz, method")
+                writer.write("whatjni::ref<${classModel.escapedName}>(whatjni::new_object(${bindingTable()}<>::clazz.get(), $methodID")
             } else {
                 when (type.returnType.sort) {
-                    Type.OBJECT, Type.ARRAY -> writer.write("$cppReturnType($callMethod<jobject>($target, method")
-                    else -> writer.write("$callMethod<$cppReturnType>($target, method")
+                    Type.OBJECT, Type.ARRAY -> writer.write("$cppReturnType($callMethod<jobject>($target, $methodID")
+                    else -> writer.write("$callMethod<$cppReturnType>($target, $methodID")
                 }
             }
 
@@ -445,6 +484,29 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
         writer.writeln("WHATJNI_IF_PROPERTY(__declspec(property($accessorsString)) $cppType ${property.escapedName};)")
     }
 
+    // Classes implemented natively may own a C++ object, their native peer, by declaring a long field named nativeHandle.
+    private fun writeNativePeer() {
+        val field = classModel.fields.find {
+            it.unescapedName == NATIVE_PEER_FIELD && it.descriptor == "J" && !isStatic(it.access)
+        }
+        if (field == null || !implementsNative || !classModel.hasNativeMethods) {
+            return
+        }
+
+        val target = "(jobject) this, ${bindingTable()}<>::${field.bindingName}.get()"
+
+        writer.writeln_lr("public:")
+        writer.writeln_r("template <typename T> T* get_native_peer() {")
+        writer.writeln("return whatjni::get_native_peer<T>($target);")
+        writer.writeln_l("}")
+        writer.writeln_r("template <typename T> T* attach_native_peer(std::unique_ptr<T> peer) {")
+        writer.writeln("return whatjni::attach_native_peer($target, std::move(peer));")
+        writer.writeln_l("}")
+        writer.writeln_r("void destroy_native_peer() {")
+        writer.writeln("whatjni::destroy_native_peer($target);")
+        writer.writeln_l("}")
+    }
+
     private fun writeMethodRegistration() {
         val nativeMethods = classModel.methods.filter { implementsNative && (it.access and Opcodes.ACC_NATIVE) != 0 }
         if (nativeMethods.isEmpty()) {
@@ -465,8 +527,7 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
         }
 
         writer.writeln_l("};")
-        writer.writeln("const static jclass clazz = whatjni::find_class(\"${classModel.unescapedName}\");")
-        writer.writeln("whatjni::register_natives(clazz, methods, ${nativeMethods.size});")
+        writer.writeln("whatjni::register_natives(${bindingTable()}<>::clazz.get(), methods, ${nativeMethods.size});")
 
         writer.writeln_l("}")
     }
@@ -526,6 +587,30 @@ class Generator(val generatedDir: File, val classMap: ClassMap, val implementsNa
         writer.writeln("#endif  // ${classModel.sentryMacro}")
     }
 
+    private fun bindingTable(): String {
+        return "jni_${classModel.escapedClassName}"
+    }
+
+    // Private members are only of interest to the C++ implementation of a class's native methods.
+    private fun isVisible(access: Int): Boolean {
+        return (access and Opcodes.ACC_PRIVATE) == 0 || (implementsNative && classModel.hasNativeMethods)
+    }
+
+    private fun isFieldBound(field: FieldModel): Boolean {
+        return isVisible(field.access) && field.value == null
+    }
+
+    private fun isMethodGenerated(method: MethodModel): Boolean {
+        if (!isVisible(method.access)) {
+            return false
+        }
+        return !method.isConstructor || (classModel.access and Opcodes.ACC_ABSTRACT) == 0
+    }
+
+    private fun isStatic(access: Int): Boolean {
+        return (access and Opcodes.ACC_STATIC) != 0
+    }
+
     private fun getModifiers(access: Int): String {
         var result = ""
         if ((access and Opcodes.ACC_STATIC) != 0) {
@@ -9,6 +9,7 @@ class MethodModel(val access: Int,
                   val signature: String?): Comparable<MethodModel> {
     val escapedName = escapeSimpleName(unescapedName)
     val jniName = "jni_" + escapedName + "_" + escapeSimpleName(descriptor)
+    val bindingName = "method_" + escapedName + "_" + escapeSimpleName(descriptor)
     val type = Type.getMethodType(descriptor)
     val isConstructor = unescapedName.equals("<init>")
 
@@ -0,0 +1,200 @@
+package whatjni.runtime;
+
+import java.lang.invoke.MethodHandle;
+import java.lang.invoke.MethodHandles;
+import java.lang.invoke.MethodType;
+import java.lang.reflect.Method;
+import java.lang.reflect.Modifier;
+import java.util.Arrays;
+
+// Replays calls recorded by whatjni::batch. Each recorded method is registered once, which binds a MethodHandle to it,
+// so replaying a call needs no lookup.
+//
+// A batch is encoded as an array of registered method indices, one per call, an array of primitive arguments, each
+// widened to its bits as a long, and an array of objects holding the receivers and reference arguments, in call order.
+// An index recorded as its complement, ~index, reuses the receiver of the previous call, which is not stored again.
+//
+// Each method's MethodHandle is adapted to read its arguments from the arrays at the call's offsets, so replaying a
+// call neither boxes primitives nor allocates an argument array.
+public final class BatchReplayer {
+    private static final MethodType REPLAY_TYPE = MethodType.methodType(
+            void.class, Object.class, long[].class, int.class, Object[].class, int.class);
+
+    private static final MethodHandle objectGetter = findGetter("getObject", Object.class, Object[].class);
+    private static final MethodHandle[] primitiveGetters = {
+        findGetter("getBoolean", boolean.class, long[].class),
+        findGetter("getByte", byte.class, long[].class),
+        findGetter("getChar", char.class, long[].class),
+        findGetter("getShort", short.class, long[].class),
+        findGetter("getInt", int.class, long[].class),
+        findGetter("getLong", long.class, long[].class),
+        findGetter("getFloat", float.class, long[].class),
+        findGetter("getDouble", double.class, long[].class),
+    };
+
+    private static final class Entry {
+        final MethodHandle handle;  // of type REPLAY_TYPE
+        final boolean isStatic;
+        final String kinds;
+        final int numPrimitives;
+        final int numObjects;  // excluding the receiver
+
+        Entry(MethodHandle handle, boolean isStatic, String kinds, int numPrimitives, int numObjects) {
+            this.handle = handle;
+            this.isStatic = isStatic;
+            this.kinds = kinds;
+            this.numPrimitives = numPrimitives;
+            this.numObjects = numObjects;
+        }
+    }
+
+    private static volatile Entry[] entries = new Entry[0];
+
+    private BatchReplayer() {
+    }
+
+    // Returns the index to record for calls to method.
+    public static synchronized int register(Method method) throws ReflectiveOperationException {
+        method.setAccessible(true);
+        boolean isStatic = Modifier.isStatic(method.getModifiers());
+        Class<?>[] parameterTypes = method.getParameterTypes();
+        MethodHandle handle = MethodHandles.lookup().unreflect(method);
+        handle = handle.asType(handle.type().changeReturnType(void.class));
+
+        int first = isStatic ? 0 : 1;
+        int numPrimitives = 0;
+        int numObjects = 0;
+        StringBuilder kinds = new StringBuilder();
+        for (Class<?> type : parameterTypes) {
+            if (type.isPrimitive()) {
+                kinds.append(kind(type));
+                ++numPrimitives;
+            } else {
+                kinds.append('L');
+                ++numObjects;
+            }
+        }
+
+        // Replaces each parameter, last first so the positions of those before it do not change, with an array and
+        // the call's offset into it, then merges the copies of the arrays and offsets into REPLAY_TYPE's.
+        int[] reorder = new int[first + 2 * parameterTypes.length];
+        int p = numPrimitives;
+        int o = numObjects;
+        for (int i = parameterTypes.length - 1; i >= 0; --i) {
+            Class<?> type = parameterTypes[i];
+            MethodHandle argument;
+            if (type.isPrimitive()) {
+                argument = MethodHandles.insertArguments(getter(kind(type)), 2, --p);
+                reorder[first + 2 * i] = 1;
+                reorder[first + 2 * i + 1] = 2;
+            } else {
+                argument = MethodHandles.insertArguments(objectGetter, 2, --o)
+                        .asType(MethodType.methodType(type, Object[].class, int.class));
+                reorder[first + 2 * i] = 3;
+                reorder[first + 2 * i + 1] = 4;
+            }
+            handle = MethodHandles.collectArguments(handle, first + i, argument);
+        }
+        if (!isStatic) {
+            handle = handle.asType(handle.type().changeParameterType(0, Object.class));
+        }
+        handle = MethodHandles.permuteArguments(handle, REPLAY_TYPE, reorder);
+
+        Entry[] newEntries = Arrays.copyOf(entries, entries.length + 1);
+        newEntries[entries.length] = new Entry(handle, isStatic, kinds.toString(), numPrimitives, numObjects);
+        entries = newEntries;
+        return entries.length - 1;
+    }
+
+    // One character per parameter, as in a JNI type signature, except that every reference type is 'L'.
+    public static String getKinds(int index) {
+        return entries[index].kinds;
+    }
+
+    public static void replay(int count, int[] methods, long[] primitives, Object[] objects) throws Throwable {
+        Entry[] entries = BatchReplayer.entries;
+        Object receiver = null;
+        int p = 0;
+        int o = 0;
+        try {
+            for (int i = 0; i < count; ++i) {
+                int index = methods[i];
+                Entry entry;
+                if (index >= 0) {
+                    entry = entries[index];
+                    if (!entry.isStatic) {
+                        receiver = objects[o++];
+                    }
+                } else {
+                    entry = entries[~index];
+                }
+                entry.handle.invokeExact(receiver, primitives, p, objects, o);
+                p += entry.numPrimitives;
+                o += entry.numObjects;
+            }
+        } finally {
+            Arrays.fill(objects, null);
+        }
+    }
+
+    private static char kind(Class<?> type) {
+        if (type == boolean.class) return 'Z';
+        if (type == byte.class) return 'B';
+        if (type == char.class) return 'C';
+        if (type == short.class) return 'S';
+        if (type == int.class) return 'I';
+        if (type == long.class) return 'J';
+        if (type == float.class) return 'F';
+        return 'D';
+    }
+
+    private static MethodHandle getter(char kind) {
+        return primitiveGetters["ZBCSIJFD".indexOf(kind)];
+    }
+
+    private static MethodHandle findGetter(String name, Class<?> type, Class<?> arrayType) {
+        try {
+            return MethodHandles.lookup().findStatic(BatchReplayer.class, name,
+                                                     MethodType.methodType(type, arrayType, int.class, int.class));
+        } catch (ReflectiveOperationException e) {
+            throw new AssertionError(e);
+        }
+    }
+
+    // The getters read the argument at index i of a call whose arguments start at offset.
+    private static Object getObject(Object[] objects, int offset, int i) {
+        return objects[offset + i];
+    }
+
+    private static boolean getBoolean(long[] primitives, int offset, int i) {
+        return primitives[offset + i] != 0;
+    }
+
+    private static byte getByte(long[] primitives, int offset, int i) {
+        return (byte) primitives[offset + i];
+    }
+
+    private static char getChar(long[] primitives, int offset, int i) {
+        return (char) primitives[offset + i];
+    }
+
+    private static short getShort(long[] primitives, int offset, int i) {
+        return (short) primitives[offset + i];
+    }
+
+    private static int getInt(long[] primitives, int offset, int i) {
+        return (int) primitives[offset + i];
+    }
+
+    private static long getLong(long[] primitives, int offset, int i) {
+        return primitives[offset + i];
+    }
+
+    private static float getFloat(long[] primitives, int offset, int i) {
+        return Float.intBitsToFloat((int) primitives[offset + i]);
+    }
+
+    private static double getDouble(long[] primitives, int offset, int i) {
+        return Double.longBitsToDouble(primitives[offset + i]);
+    }
+}
@@ -0,0 +1,40 @@
+package whatjni.runtime;
+
+import java.util.concurrent.CompletionException;
+import java.util.function.BiConsumer;
+
+// Calls a native function, identified by an opaque handle, the first time either run() or accept() is called. Later
+// calls do nothing. Created by whatjni::new_native_callback.
+public final class NativeCallback implements Runnable, BiConsumer<Object, Throwable> {
+    private long handle;
+
+    private NativeCallback(long handle) {
+        this.handle = handle;
+    }
+
+    @Override
+    public void run() {
+        accept(null, null);
+    }
+
+    @Override
+    public void accept(Object result, Throwable error) {
+        long h;
+        synchronized (this) {
+            h = handle;
+            handle = 0;
+        }
+        if (h == 0) {
+            return;
+        }
+
+        // Dependent stages of a CompletableFuture wrap the exception that completed the original stage.
+        if (error instanceof CompletionException && error.getCause() != null) {
+            error = error.getCause();
+        }
+
+        invoke(h, result, error);
+    }
+
+    private static native void invoke(long handle, Object result, Throwable error);
+}
@@ -0,0 +1,84 @@
+package whatjni.runtime;
+
+import java.lang.invoke.MethodHandle;
+import java.lang.invoke.MethodHandles;
+import java.lang.invoke.MethodType;
+import java.lang.ref.PhantomReference;
+import java.lang.ref.ReferenceQueue;
+import java.util.Collections;
+import java.util.IdentityHashMap;
+import java.util.Set;
+
+// Runs an action, once, when an object becomes phantom reachable. Used by whatjni::attach_native_peer to destroy the
+// native peers of Java objects.
+//
+// On Java 9 and later this registers the action with a java.lang.ref.Cleaner. Java 8 has no Cleaner, so there a daemon
+// thread of this class's own drains a queue of phantom references in the same way. The runtime targets Java 8, so the
+// Cleaner is only found reflectively.
+public final class PeerCleaner {
+    private static final MethodHandle cleanerRegister = findCleanerRegister();
+
+    // Phantom references must stay reachable until they are enqueued.
+    private static final Set<Phantom> phantoms = Collections.synchronizedSet(
+            Collections.newSetFromMap(new IdentityHashMap<Phantom, Boolean>()));
+    private static ReferenceQueue<Object> queue;
+
+    private static final class Phantom extends PhantomReference<Object> {
+        final Runnable action;
+
+        Phantom(Object referent, Runnable action, ReferenceQueue<Object> queue) {
+            super(referent, queue);
+            this.action = action;
+        }
+    }
+
+    private PeerCleaner() {
+    }
+
+    public static void register(Object obj, Runnable action) throws Throwable {
+        if (cleanerRegister != null) {
+            cleanerRegister.invokeExact(obj, action);
+        } else {
+            phantoms.add(new Phantom(obj, action, getQueue()));
+        }
+    }
+
+    private static MethodHandle findCleanerRegister() {
+        try {
+            Class<?> cleanerClass = Class.forName("java.lang.ref.Cleaner");
+            Class<?> cleanableClass = Class.forName("java.lang.ref.Cleaner$Cleanable");
+            Object cleaner = cleanerClass.getMethod("create").invoke(null);
+            return MethodHandles.publicLookup()
+                    .findVirtual(cleanerClass, "register",
+                                 MethodType.methodType(cleanableClass, Object.class, Runnable.class))
+                    .bindTo(cleaner)
+                    .asType(MethodType.methodType(void.class, Object.class, Runnable.class));
+        } catch (ReflectiveOperationException e) {
+            return null;
+        }
+    }
+
+    private static synchronized ReferenceQueue<Object> getQueue() {
+        if (queue == null) {
+            final ReferenceQueue<Object> q = new ReferenceQueue<>();
+            Thread thread = new Thread(new Runnable() {
+                @Override
+                public void run() {
+                    for (;;) {
+                        try {
+                            Phantom phantom = (Phantom) q.remove();
+                            phantoms.remove(phantom);
+                            phantom.action.run();
+                        } catch (Throwable t) {
+                            // Like Cleaner, ignore exceptions thrown by actions.
+                        }
+                    }
+                }
+            }, "whatjni-peer-cleaner");
+            thread.setDaemon(true);
+            thread.start();
+            queue = q;
+        }
+        return queue;
+    }
+}
@@ -1,10 +1,16 @@
 package whatjni.samples;
 
 public class Calculator {
+    // Handle to the C++ object holding the calculator's memory.
+    private long nativeHandle;
+
     public int calculate() {
-        return staticAdd(instanceMultiply(2, 3), 1);
+        remember(staticAdd(instanceMultiply(2, 3), 1));
+        return recall();
     }
 
     public static native int staticAdd(int a, int b);
     public native int instanceMultiply(int a, int b);
+    public native void remember(int value);
+    public native int recall();
 }
@@ -2,10 +2,16 @@
 #include "whatjni/samples/register_natives.h"
 
 #include <iostream>
+#include <memory>
 
 using whatjni::samples::Calculator;
 using namespace whatjni;
 
+// Native peer of each Calculator, destroyed once the Calculator is garbage collected.
+struct calculator_memory {
+    jint value = 0;
+};
+
 int main(int argc, const char** argv) {
     initialize_vm(vm_config(JNI_VERSION_1_8));
 
@@ -26,4 +32,17 @@ jint Calculator::native_staticAdd(jint a, jint b) {
 
 jint Calculator::native_instanceMultiply(jint a, jint b) {
     return a * b;
-}
\ No newline at end of file
+}
+
+void Calculator::native_remember(jint value) {
+    auto memory = get_native_peer<calculator_memory>();
+    if (!memory) {
+        memory = attach_native_peer(std::make_unique<calculator_memory>());
+    }
+    memory->value = value;
+}
+
+jint Calculator::native_recall() {
+    auto memory = get_native_peer<calculator_memory>();
+    return memory ? memory->value : 0;
+}